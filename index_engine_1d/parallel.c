@@ -8,11 +8,15 @@
 // full optimization: gcc -o parallel parallel.c -std=c99 -lglut -lGL -lm -O3 -fno-stack-protector
 // prev and OpenMP:   gcc -o parallel parallel.c -std=c99 -lglut -lGL -lm -O3 -fopenmp -fno-stack-protector
 // prev and OpenCL:   gcc -o parallel parallel.c -std=c99 -lglut -lGL -lm -O3 -fopenmp -lOpenCL -fno-stack-protector
+// headless, no GL:   gcc -o parallel parallel.c -std=c99 -lm -O3 -fopenmp -lOpenCL -fno-stack-protector -DHEADLESS=1
  
 // Example compilation on macos X
 // no optimization:   gcc -o parallel parallel.c -std=c99 -framework GLUT -framework OpenGL
 // full optimization: gcc -o parallel parallel.c -std=c99 -framework GLUT -framework OpenGL -O3
 
+// clock_gettime of headless mode, ftruncate of frame dump
+#define _POSIX_C_SOURCE 200112L
+
 #ifdef _WIN32
 #include <windows.h>
 #endif
@@ -27,8 +31,18 @@
 #include <CL/cl.h>
 #define __CL_ENABLE_EXCEPTIONS
 
+// Define HEADLESS 1 to run frames without window or GL context, frame count
+// is given after the seed on command line
+#ifndef HEADLESS
+#define HEADLESS 0
+#endif
+#define HEADLESS_FRAMES 100
+
 // Window handling includes
-#ifndef __APPLE__
+#if HEADLESS
+#include <time.h>
+#elif !defined(__APPLE__)
+#define GL_GLEXT_PROTOTYPES //Shader and multitexture functions of the palette display
 #include <GL/gl.h>
 #include <GL/glut.h>
 #else
@@ -65,6 +79,27 @@ typedef struct{
    float blue;
 } color;
 
+// Define framebuffer format: 0 three floats per pixel, 1 RGBA with a byte per channel
+#ifndef RGBA8_FRAMEBUFFER
+#define RGBA8_FRAMEBUFFER 0
+#endif
+
+// Stores one pixel of the framebuffers in the format given to glDrawPixels
+#if RGBA8_FRAMEBUFFER
+typedef struct{
+   uint8_t red;
+   uint8_t green;
+   uint8_t blue;
+   uint8_t alpha;
+} pixel_color;
+#define PIXEL_GL_FORMAT GL_RGBA
+#define PIXEL_GL_TYPE GL_UNSIGNED_BYTE
+#else
+typedef color pixel_color;
+#define PIXEL_GL_FORMAT GL_RGB
+#define PIXEL_GL_TYPE GL_FLOAT
+#endif
+
 // Stores the satelite data, which fly around black hole in the space
 typedef struct{
    color identifier;
@@ -73,15 +108,18 @@ typedef struct{
 } satelite;
 
 // Pixel buffer which is rendered to the screen
-color* pixels;
+pixel_color* pixels;
 
 // Pixel buffer which is used for error checking
-color* correctPixels;
+pixel_color* correctPixels;
 
 // Buffer for all satelites in the space
 satelite* satelites;
 
 // ## You may add your own variables here ##
+
+// Physics step in milliseconds given with --dt on command line, 0 uses frame time
+int fixedDeltaTime = 0;
 #define LOCAL_ITEM_SIZE 32
 #define MAX_CL_DEVICES 5
 #define MAX_SOURCE_SIZE (0x100000)
@@ -98,6 +136,209 @@ satelite* satelites;
 int device_ratio[2] = {14, 2}; //Share between opencl Devices, first device gets sum/ratio.
 //You need to change this based on device positions
 
+//Define which render pipeline is used
+#define BRUTE_FORCE 1
+#define JUMP_FLOOD 2
+#define BLOCK_FILL 3
+#define TILE_BINNING 4
+#define TEMPORAL_COHERENCE 5
+#define DIRTY_REGION 6
+#ifndef RENDER_MODE
+#define RENDER_MODE BRUTE_FORCE // BRUTE_FORCE: every pixel checks all satelites, white disks are stamped in a second pass, JUMP_FLOOD: seed satelites, do log2(N) flooding passes and recheck cell boundaries,
+                                // BLOCK_FILL: fill tiles whose corners share an owner, test sub blocks of the others,
+                                // TILE_BINNING: host builds candidate satelite list for every tile,
+                                // TEMPORAL_COHERENCE: pixels keep last frame's owner while satelites have not moved enough to change it,
+                                // DIRTY_REGION: as previous but only pixels which changed color are read back
+#endif
+#define FILL_TILE 16 //Must match FILL_TILE in the kernel file
+#define DISK_SPAN ((int)(2 * SATELITE_RADIUS) + 2) //Must match DISK_SPAN in the kernel file
+
+//Define which integrator moves the satelites
+#define EULER_REFERENCE 1
+#define LEAPFROG 2
+#define RK4 3
+#define ADAPTIVE_RK 4
+#ifndef INTEGRATOR
+#define INTEGRATOR EULER_REFERENCE // EULER_REFERENCE: gravity once a frame and 10000 Euler updates, as in the exercise,
+                                   // LEAPFROG: velocity Verlet with INTEGRATOR_STEPS steps a frame,
+                                   // RK4: classic Runge-Kutta with INTEGRATOR_STEPS steps a frame,
+                                   // ADAPTIVE_RK: Dormand-Prince 5(4) with step size kept below INTEGRATOR_TOLERANCE
+#endif
+#ifndef INTEGRATOR_STEPS
+#define INTEGRATOR_STEPS 4
+#endif
+#ifndef INTEGRATOR_TOLERANCE
+#define INTEGRATOR_TOLERANCE 1e-6 //Allowed error of one adaptive step in pixels
+#endif
+
+//Define SIMD_PHYSICS 1 to integrate 16/8/4 satelites at once in AVX-512/AVX/SSE2 lanes on host,
+//best is picked at runtime
+#ifndef SIMD_PHYSICS
+#define SIMD_PHYSICS 0
+#endif
+#if SIMD_PHYSICS && INTEGRATOR != EULER_REFERENCE
+#error "SIMD_PHYSICS runs the Euler reference, it cannot be used with other integrators"
+#endif
+#if SIMD_PHYSICS
+#include <immintrin.h>
+#define PHYSICS_LANE_CAPACITY ((SATELITE_COUNT + 15) / 16 * 16) //Arrays are padded to whole AVX-512 vectors
+#endif
+
+//Define GRAVITY_FIELD 1 to replace the black hole term with a precomputed acceleration field of
+//all attractors, device samples it from an image with bilinear filtering at every substep
+#ifndef GRAVITY_FIELD
+#define GRAVITY_FIELD 0
+#endif
+#ifndef ATTRACTOR_COUNT
+#define ATTRACTOR_COUNT 1 //Black hole in the center, others evenly on a ring around it
+#endif
+#define ATTRACTOR_RING 350.0
+#define ATTRACTOR_GRAVITY (0.25 * GRAVITY)
+#define FIELD_CELL 4 //Grid spacing in pixels, must match FIELD_CELL in the kernel file
+#define FIELD_MARGIN (WINDOW_WIDTH / 2) //Field reaches this far outside the window, must match FIELD_MARGIN in the kernel file
+#define FIELD_COLUMNS ((WINDOW_WIDTH + 2 * FIELD_MARGIN) / FIELD_CELL + 1)
+#define FIELD_ROWS ((WINDOW_HEIGHT + 2 * FIELD_MARGIN) / FIELD_CELL + 1)
+#define FIELD_SOFTENING 0.5 //Pixels, keeps the field finite at attractors
+
+//Define where physics runs: 0 on host and satelites are uploaded every frame, 1 integrate kernel
+//moves satelites kept on every device and host reads them back only for error checked frames
+#ifndef DEVICE_PHYSICS
+#define DEVICE_PHYSICS 0
+#endif
+#if DEVICE_PHYSICS && INTEGRATOR != EULER_REFERENCE
+#error "DEVICE_PHYSICS runs the Euler reference, it cannot be used with other integrators"
+#endif
+#if DEVICE_PHYSICS && SIMD_PHYSICS
+#error "SIMD_PHYSICS runs physics on host, it cannot be used with DEVICE_PHYSICS"
+#endif
+#if GRAVITY_FIELD && !DEVICE_PHYSICS
+#error "GRAVITY_FIELD is sampled by the integrate kernel, it needs DEVICE_PHYSICS"
+#endif
+#if DEVICE_PHYSICS && (RENDER_MODE == TILE_BINNING || RENDER_MODE == TEMPORAL_COHERENCE || RENDER_MODE == DIRTY_REGION)
+#error "TILE_BINNING, TEMPORAL_COHERENCE and DIRTY_REGION need satelite positions on host every frame, they cannot be used with DEVICE_PHYSICS"
+#endif
+
+//Define how satelite ids are read back: 0 one id per pixel, 1 run length encoded rows
+#ifndef RLE_READBACK
+#define RLE_READBACK 0
+#endif
+#if RLE_READBACK && RENDER_MODE == DIRTY_REGION
+#error "DIRTY_REGION reads back only changed pixels, it cannot be used with RLE_READBACK"
+#endif
+#if RLE_READBACK && SATELITE_COUNT >= 0xFFFF
+#error "Runs store satelite id in 16 bits"
+#endif
+
+//Define delta frame readback: 1 reads back only pixels whose id changed since previous frame
+#ifndef DELTA_READBACK
+#define DELTA_READBACK 0
+#endif
+#if DELTA_READBACK && (RLE_READBACK || RENDER_MODE == DIRTY_REGION)
+#error "DELTA_READBACK cannot be used with RLE_READBACK or DIRTY_REGION"
+#endif
+
+//Define how frames are displayed: 0 colors pixels on host and draws floats, 1 uploads
+//satelite ids as a texture and colors them with a palette in a fragment shader
+#ifndef PALETTE_DISPLAY
+#define PALETTE_DISPLAY 0
+#endif
+#if PALETTE_DISPLAY && (RLE_READBACK || DELTA_READBACK || RENDER_MODE == DIRTY_REGION)
+#error "PALETTE_DISPLAY needs the satelite ids of whole frame, it cannot be used with RLE_READBACK, DELTA_READBACK or DIRTY_REGION"
+#endif
+
+//Define pixel upload: 0 glDrawPixels copies from host memory, 1 colors are written
+//to one of two mapped pixel buffer objects while the other is drawn
+#ifndef PBO_DISPLAY
+#define PBO_DISPLAY 0
+#endif
+#if PBO_DISPLAY && (PALETTE_DISPLAY || DELTA_READBACK || RENDER_MODE == DIRTY_REGION)
+#error "PBO_DISPLAY needs every pixel written on every frame, it cannot be used with PALETTE_DISPLAY, DELTA_READBACK or DIRTY_REGION"
+#endif
+#if HEADLESS && (PALETTE_DISPLAY || PBO_DISPLAY)
+#error "PALETTE_DISPLAY and PBO_DISPLAY draw with GL, they cannot be used with HEADLESS"
+#endif
+
+//Define frame dump: 0 off, DUMP_PIXELS colors as concatenated binary PPM frames (top row first),
+//DUMP_IDS satelite ids as raw frames of uint8 (int over 254 satelites) per pixel (bottom row first)
+#define DUMP_PIXELS 1
+#define DUMP_IDS 2
+#ifndef FRAME_DUMP
+#define FRAME_DUMP 0
+#endif
+#define DUMP_RING 4 //Frames mapped ahead of the frame loop
+#if FRAME_DUMP == DUMP_PIXELS && (PALETTE_DISPLAY || PBO_DISPLAY)
+#error "DUMP_PIXELS reads pixels of every frame, it cannot be used with PALETTE_DISPLAY or PBO_DISPLAY"
+#endif
+#if FRAME_DUMP == DUMP_IDS && (PALETTE_DISPLAY || RLE_READBACK || DELTA_READBACK || RENDER_MODE == DIRTY_REGION)
+#error "DUMP_IDS needs satelite ids of whole frame read back to it, it cannot be used with PALETTE_DISPLAY, RLE_READBACK, DELTA_READBACK or DIRTY_REGION"
+#endif
+#if FRAME_DUMP
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <time.h>
+#endif
+#define SCAN_GROUP 256 //Must match SCAN_GROUP in the kernel file
+#define SCAN_LEVELS 4 //Scan handles up to SCAN_GROUP^SCAN_LEVELS items
+
+//Tile binning: tile size and compact candidate lists of all tiles
+#define BIN_TILE 16
+#define TILES_IN_ROW ((WINDOW_WIDTH + BIN_TILE - 1) / BIN_TILE)
+#define TILE_COUNT (TILES_IN_ROW * ((WINDOW_HEIGHT + BIN_TILE - 1) / BIN_TILE))
+int* tile_start; //TILE_COUNT + 1 offsets to tile_candidates
+float* tile_bound; //Squared candidate distance bound from tile center
+int* tile_candidates;
+int tile_candidates_capacity = 0;
+
+//Framebuffer colors of satelites and their disks, expanding ids needs no conversion
+pixel_color* satelite_colors;
+pixel_color white_color;
+
+//Distance every satelite moved in the last physics update
+double* satelite_displacement;
+#if SIMD_PHYSICS
+//Satelite state as structure of arrays for vector loads
+float* physics_position_x;
+float* physics_position_y;
+float* physics_velocity_x;
+float* physics_velocity_y;
+void (*simd_integrate)(int first, float deltaTime, float updates); //Integrates satelites [first, first + simd_physics_lanes) for one frame
+int simd_physics_lanes;
+void selectSimdIntegrate();
+#endif
+#if GRAVITY_FIELD
+//Point mass whose gravity is summed to the field
+typedef struct{
+	double x;
+	double y;
+	double gravity;
+} attractor;
+attractor* attractors;
+float* gravity_field; //Acceleration x and y of every grid point, rows from the top
+void buildGravityField();
+#endif
+#if INTEGRATOR == ADAPTIVE_RK
+double* integrator_step; //Step size of every satelite is kept between frames, 0 until first frame
+#endif
+int first_rendered_frame = 1;
+
+//Readback entry of one changed pixel in dirty region and delta frame modes, must match the kernel file
+#if SATELITE_COUNT < 255
+typedef cl_uint dirty_entry; //Pixel index of the share in high 24 bits, satelite id in low 8 bits
+#define DIRTY_ENTRY_INDEX(entry) ((entry) >> 8)
+#define DIRTY_ENTRY_ID(entry) ((entry) & 0xFF)
+#define DIRTY_WHITE 0xFF
+#else
+typedef struct{
+	cl_int index;
+	cl_int id;
+} dirty_entry;
+#define DIRTY_ENTRY_INDEX(entry) ((entry).index)
+#define DIRTY_ENTRY_ID(entry) ((entry).id)
+#define DIRTY_WHITE 0xFFFF
+#endif
+
 // Some helpers to window size variables
 #define SIZE WINDOW_HEIGHT*WINDOW_HEIGHT
 #define HORIZONTAL_CENTER (WINDOW_WIDTH / 2)
@@ -110,7 +351,16 @@ int device_ratio[2] = {14, 2}; //Share between opencl Devices, first device gets
 				" -D WINDOW_HEIGHT=" TEXTIFY(HEIGHT)	\
  				" -D SAT_RADIUS=" TEXTIFY(RAD)  			\
 				" -D SAT_COUNT=" TEXTIFY(CNT)
-#define CL_OPTIONS _OPTION_CREATOR(WINDOW_WIDTH, WINDOW_HEIGHT, SATELITE_RADIUS, SATELITE_COUNT)
+#define _TILE_OPTION_CREATOR(TILE) " -D BIN_TILE=" TEXTIFY(TILE)
+#if DEVICE_PHYSICS && GRAVITY_FIELD
+#define _PHYSICS_OPTION_CREATOR(G) " -D GRAVITY=" TEXTIFY(G) " -cl-fp32-correctly-rounded-divide-sqrt -D GRAVITY_FIELD"
+#elif DEVICE_PHYSICS
+//Devices must round like the host to keep their copies of satelites equal
+#define _PHYSICS_OPTION_CREATOR(G) " -D GRAVITY=" TEXTIFY(G) " -cl-fp32-correctly-rounded-divide-sqrt"
+#else
+#define _PHYSICS_OPTION_CREATOR(G) " -D GRAVITY=" TEXTIFY(G)
+#endif
+#define CL_OPTIONS _OPTION_CREATOR(WINDOW_WIDTH, WINDOW_HEIGHT, SATELITE_RADIUS, SATELITE_COUNT) _TILE_OPTION_CREATOR(BIN_TILE) _PHYSICS_OPTION_CREATOR(GRAVITY)
 
 typedef struct DeviceDesc{
 	cl_device_id    deviceId;
@@ -127,6 +377,74 @@ typedef struct ClDevice{
 	cl_mem pixel_start_offset_y;
 	cl_program program;
 	cl_kernel kernel;
+#if DEVICE_PHYSICS
+	cl_kernel integrate_kernel;
+#endif
+#if GRAVITY_FIELD
+	cl_mem field_image; //Acceleration of the attractors, red x and green y
+#endif
+#if RENDER_MODE == BRUTE_FORCE || RENDER_MODE == JUMP_FLOOD
+	cl_kernel disk_kernel;
+#endif
+#if RENDER_MODE == JUMP_FLOOD
+	cl_mem owner_gpu[2]; //Ping-pong owner buffers covering the whole window
+	cl_kernel jfa_clear_kernel;
+	cl_kernel jfa_seed_kernel;
+	cl_kernel jfa_reseed_kernel;
+	cl_kernel jfa_step_kernel;
+	cl_kernel jfa_refine_kernel;
+	cl_kernel jfa_resolve_kernel;
+#endif
+#if RENDER_MODE == BLOCK_FILL
+	cl_kernel block_kernel;
+	size_t block_global_size; //One work item per tile of device share
+#endif
+#if RENDER_MODE == TILE_BINNING
+	cl_kernel tile_kernel;
+	cl_mem tile_start_gpu;
+	cl_mem tile_candidates_gpu;
+	int tile_candidates_size; //Capacity of tile_candidates_gpu in elements
+#endif
+#if RENDER_MODE == TEMPORAL_COHERENCE
+	cl_kernel coherent_kernel;
+	cl_mem last_owner_gpu; //Owner of every pixel of device share, kept between frames
+	cl_mem last_margin_gpu; //Distance gap to the second closest satelite
+#endif
+#if RENDER_MODE == DIRTY_REGION
+	cl_kernel dirty_kernel;
+	cl_mem last_owner_gpu;
+	cl_mem last_margin_gpu;
+	cl_mem last_disk_gpu; //Signed distance from the owner disk edge, negative inside
+#endif
+#if RENDER_MODE == DIRTY_REGION || DELTA_READBACK
+	cl_mem dirty_gpu; //Changed pixels of the frame, at most whole share
+	cl_mem dirty_count_gpu;
+	dirty_entry* dirty;
+	int dirty_count;
+#endif
+#if DELTA_READBACK
+	cl_kernel delta_flags_kernel;
+	cl_kernel delta_scatter_kernel;
+	cl_kernel scan_blocks_kernel;
+	cl_kernel scan_add_kernel;
+	cl_mem previous_ids_gpu; //sat_ids of previous frame
+	cl_mem delta_flags_gpu;
+	cl_mem delta_offsets_gpu;
+	cl_mem scan_sums_gpu[SCAN_LEVELS]; //Block totals of every scan level
+	cl_mem scan_offsets_gpu[SCAN_LEVELS]; //Scanned block totals
+	int delta_all_changed; //Set until previous_ids_gpu holds a frame
+#endif
+#if RLE_READBACK
+	cl_kernel rle_count_kernel;
+	cl_kernel rle_offsets_kernel;
+	cl_kernel rle_write_kernel;
+	cl_mem row_runs_gpu;
+	cl_mem row_offsets_gpu; //share_rows + 1 offsets to runs_gpu
+	cl_mem runs_gpu; //Satelite id in high 16 bits, run length in low 16 bits
+	int share_rows;
+	int* row_offsets;
+	cl_uint* runs;
+#endif
 	cl_command_queue command_queue;
 	cl_context context;
 	cl_device_id device_id;
@@ -151,6 +469,20 @@ typedef struct ClDevice{
 ClDevice* cl_devices;
 int num_of_cldevices = 0;
 
+/*
+	Converts a color to framebuffer format. Bytes are rounded to nearest like
+	GL does for float pixels, colors are always within 0.0f ... 1.0f
+*/
+pixel_color toPixelColor(color c){
+#if RGBA8_FRAMEBUFFER
+	pixel_color p = {.red = (uint8_t)(c.red * 255.0f + 0.5f), .green = (uint8_t)(c.green * 255.0f + 0.5f),
+	                 .blue = (uint8_t)(c.blue * 255.0f + 0.5f), .alpha = 255};
+	return p;
+#else
+	return c;
+#endif
+}
+
 
 /*
 	OpenCL commands error handler
@@ -339,6 +671,378 @@ int get_platforms_and_devices(ClDevice *CLdevices){
 	return end_devices;
 }
 
+#if PALETTE_DISPLAY
+//Satelite ids of whole window, device shares are read back straight into it
+#if SATELITE_COUNT < 255
+uint8_t* owner_ids;
+#else
+int* owner_ids;
+#endif
+GLuint owner_texture;
+GLuint palette_texture;
+GLuint palette_program;
+
+//Ids are read back as normalized bytes: one luminance byte, or low and high
+//byte of an int in red and green
+const char* palette_shader_source =
+	"uniform sampler2D owners;\n"
+	"uniform sampler1D palette;\n"
+	"uniform vec2 id_weights;\n"
+	"uniform float white_id;\n"
+	"uniform float palette_size;\n"
+	"void main(){\n"
+	"	vec4 texel = texture2D(owners, gl_TexCoord[0].st);\n"
+	"	float id = floor(dot(texel.rg, id_weights) + 0.5);\n"
+	"	gl_FragColor = id == white_id ? vec4(1.0) : texture1D(palette, (id + 0.5) / palette_size);\n"
+	"}\n";
+
+/*
+	Compiles the palette shader and creates owner and palette textures.
+	Satelite colors do not change, so palette is uploaded only once
+*/
+void initPaletteDisplay(){
+	GLint max_size = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+	if (max_size < SATELITE_COUNT || max_size < WINDOW_WIDTH || max_size < WINDOW_HEIGHT){
+		fprintf(stderr, "Palette display needs textures of %d texels\n", SATELITE_COUNT);
+		exit(1);
+	}
+	
+	GLuint shader = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(shader, 1, &palette_shader_source, NULL);
+	glCompileShader(shader);
+	GLint status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status != GL_TRUE){
+		char log[1024];
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		fprintf(stderr, "Palette shader does not compile:\n%s\n", log);
+		exit(1);
+	}
+	palette_program = glCreateProgram();
+	glAttachShader(palette_program, shader);
+	glLinkProgram(palette_program);
+	glGetProgramiv(palette_program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE){
+		fprintf(stderr, "Palette shader does not link\n");
+		exit(1);
+	}
+	glDeleteShader(shader);
+	
+	glUseProgram(palette_program);
+	glUniform1i(glGetUniformLocation(palette_program, "owners"), 0);
+	glUniform1i(glGetUniformLocation(palette_program, "palette"), 1);
+	glUniform1f(glGetUniformLocation(palette_program, "palette_size"), SATELITE_COUNT);
+#if SATELITE_COUNT < 255
+	glUniform2f(glGetUniformLocation(palette_program, "id_weights"), 255.0f, 0.0f);
+	glUniform1f(glGetUniformLocation(palette_program, "white_id"), 0xFF);
+#else
+	glUniform2f(glGetUniformLocation(palette_program, "id_weights"), 255.0f, 255.0f * 256.0f);
+	glUniform1f(glGetUniformLocation(palette_program, "white_id"), 0xFFFF);
+#endif
+	glUseProgram(0);
+	
+	//Nearest filtering, ids must not be interpolated
+	glActiveTexture(GL_TEXTURE1);
+	glGenTextures(1, &palette_texture);
+	glBindTexture(GL_TEXTURE_1D, palette_texture);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	color* palette = (color*)malloc(sizeof(color) * SATELITE_COUNT);
+	for (int j = 0; j < SATELITE_COUNT; j++){
+		palette[j] = satelites[j].identifier;
+	}
+	glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB32F, SATELITE_COUNT, 0, GL_RGB, GL_FLOAT, palette);
+	free(palette);
+	
+	glActiveTexture(GL_TEXTURE0);
+	glGenTextures(1, &owner_texture);
+	glBindTexture(GL_TEXTURE_2D, owner_texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+#if SATELITE_COUNT < 255
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, WINDOW_WIDTH, WINDOW_HEIGHT, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, NULL);
+#else
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, WINDOW_WIDTH, WINDOW_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+#endif
+}
+
+/*
+	Uploads satelite ids of the frame and draws them through the palette
+	as a window sized quad. Texture rows go bottom up like in glDrawPixels
+*/
+void drawPaletteDisplay(){
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_1D, palette_texture);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, owner_texture);
+#if SATELITE_COUNT < 255
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, GL_LUMINANCE, GL_UNSIGNED_BYTE, owner_ids);
+#else
+	//Packed format takes red from the low byte on any endianness
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, owner_ids);
+#endif
+	glUseProgram(palette_program);
+	glBegin(GL_QUADS);
+	glTexCoord2f(0.0f, 0.0f); glVertex2f(-1.0f, -1.0f);
+	glTexCoord2f(1.0f, 0.0f); glVertex2f(1.0f, -1.0f);
+	glTexCoord2f(1.0f, 1.0f); glVertex2f(1.0f, 1.0f);
+	glTexCoord2f(0.0f, 1.0f); glVertex2f(-1.0f, 1.0f);
+	glEnd();
+	glUseProgram(0);
+}
+#endif
+
+#if PBO_DISPLAY
+GLuint pixel_buffers[2];
+int mapped_pixel_buffer = 0;
+pixel_color* host_pixels; //Buffer of fixedInit, restored for fixedDestroy
+
+/*
+	Orphans the storage of pixel buffer so that mapping does not wait for
+	earlier draw from it, and points pixels to the mapped memory. Error checked
+	frames are read back by errorCheck, so those are mapped for reading too
+*/
+void mapPixelBuffer(int b, unsigned int frame){
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffers[b]);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, sizeof(pixel_color) * SIZE, NULL, GL_STREAM_DRAW);
+	pixels = (pixel_color*)glMapBuffer(GL_PIXEL_UNPACK_BUFFER, frame < 2 ? GL_READ_WRITE : GL_WRITE_ONLY);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (pixels == NULL){
+		fprintf(stderr, "Mapping pixel buffer failed\n");
+		exit(1);
+	}
+	mapped_pixel_buffer = b;
+}
+
+void initPixelBuffers(){
+	host_pixels = pixels;
+	glGenBuffers(2, pixel_buffers);
+	mapPixelBuffer(0, frameNumber);
+}
+
+/*
+	Draws the frame from its pixel buffer and maps the other buffer for the
+	next frame. Draw reads the buffer asynchronously while next frame is colored
+*/
+void drawPixelBuffer(){
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffers[mapped_pixel_buffer]);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	glDrawPixels(WINDOW_WIDTH, WINDOW_HEIGHT, PIXEL_GL_FORMAT, PIXEL_GL_TYPE, (void*)0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	mapPixelBuffer(1 - mapped_pixel_buffer, frameNumber + 1);
+}
+
+void destroyPixelBuffers(){
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffers[mapped_pixel_buffer]);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glDeleteBuffers(2, pixel_buffers);
+	pixels = host_pixels;
+}
+#endif
+
+#if FRAME_DUMP
+/*
+	Frame dump: frames are written straight into memory mapped windows of the
+	output file. Writer thread maps and pre-faults windows ahead of the frame
+	loop and flushes and unmaps them behind it. Each cursor is advanced by one
+	thread only, so the ring needs no locks. When writer falls behind the frame
+	is dropped instead of waiting for the disk
+*/
+typedef struct DumpSlot{
+	uint8_t* map; //Page aligned start of the mapping
+	size_t map_size;
+	uint8_t* frame; //Start of the frame inside the mapping
+} DumpSlot;
+DumpSlot dump_slots[DUMP_RING];
+unsigned long dump_prepared = 0; //Frames mapped by writer
+unsigned long dump_filled = 0; //Frames filled by frame loop
+unsigned long dump_written = 0; //Frames flushed by writer
+unsigned long dump_dropped = 0;
+int dump_stop = 0;
+int dump_file;
+size_t dump_header_size;
+size_t dump_frame_size; //Header and pixels
+char dump_header[32];
+pthread_t dump_thread;
+#if FRAME_DUMP == DUMP_IDS
+#if SATELITE_COUNT < 255
+uint8_t* dump_scratch_ids; //Read back target of dropped frames
+uint8_t* dump_ids;
+#else
+int* dump_scratch_ids;
+int* dump_ids;
+#endif
+#endif
+
+/*
+	Maps the window of n:th frame. Window starts from page boundary, so it may
+	share first page with previous frame. Only bytes of this frame are touched
+*/
+void mapDumpSlot(unsigned long n){
+	long page = sysconf(_SC_PAGESIZE);
+	off_t start = (off_t)n * dump_frame_size;
+	off_t aligned = start - start % page;
+	DumpSlot* slot = &dump_slots[n % DUMP_RING];
+	if (ftruncate(dump_file, start + dump_frame_size) != 0){
+		perror("Frame dump ftruncate");
+		exit(1);
+	}
+	slot->map_size = start + dump_frame_size - aligned;
+	slot->map = (uint8_t*)mmap(NULL, slot->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, dump_file, aligned);
+	if (slot->map == MAP_FAILED){
+		perror("Frame dump mmap");
+		exit(1);
+	}
+	slot->frame = slot->map + (start - aligned);
+	//Page faults are taken here instead of in the frame loop
+	for (size_t b = 0; b < dump_frame_size; b += page){
+		slot->frame[b] = 0;
+	}
+	slot->frame[dump_frame_size - 1] = 0;
+}
+
+void* dumpWriter(void* arg){
+	struct timespec idle_time = {.tv_sec = 0, .tv_nsec = 1000000};
+	for (;;){
+		int idle = 1;
+		unsigned long filled = __atomic_load_n(&dump_filled, __ATOMIC_ACQUIRE);
+		if (dump_written < filled){
+			DumpSlot* slot = &dump_slots[dump_written % DUMP_RING];
+			msync(slot->map, slot->map_size, MS_SYNC);
+			munmap(slot->map, slot->map_size);
+			__atomic_store_n(&dump_written, dump_written + 1, __ATOMIC_RELEASE);
+			idle = 0;
+		}
+		else if (__atomic_load_n(&dump_stop, __ATOMIC_ACQUIRE)){
+			//Frame loop may have filled one more frame before stopping
+			if (dump_written == __atomic_load_n(&dump_filled, __ATOMIC_ACQUIRE)){
+				break;
+			}
+			continue;
+		}
+		if (dump_prepared < dump_written + DUMP_RING){
+			mapDumpSlot(dump_prepared);
+			__atomic_store_n(&dump_prepared, dump_prepared + 1, __ATOMIC_RELEASE);
+			idle = 0;
+		}
+		if (idle){
+			nanosleep(&idle_time, NULL);
+		}
+	}
+	//Drop windows which were mapped but never filled
+	for (unsigned long n = dump_written; n < dump_prepared; n++){
+		munmap(dump_slots[n % DUMP_RING].map, dump_slots[n % DUMP_RING].map_size);
+	}
+	if (ftruncate(dump_file, (off_t)dump_written * dump_frame_size) != 0){
+		perror("Frame dump ftruncate");
+	}
+	return arg;
+}
+
+//Next mapped frame of the dump, NULL if writer has not mapped one yet
+uint8_t* acquireDumpFrame(){
+	if (dump_filled == __atomic_load_n(&dump_prepared, __ATOMIC_ACQUIRE)){
+		dump_dropped++;
+		return NULL;
+	}
+	return dump_slots[dump_filled % DUMP_RING].frame;
+}
+
+void publishDumpFrame(){
+	__atomic_store_n(&dump_filled, dump_filled + 1, __ATOMIC_RELEASE);
+}
+
+void startFrameDump(){
+#if FRAME_DUMP == DUMP_PIXELS
+	const char* file_name = "frames.ppm";
+	dump_header_size = sprintf(dump_header, "P6\n%d %d\n255\n", WINDOW_WIDTH, WINDOW_HEIGHT);
+	dump_frame_size = dump_header_size + 3 * (size_t)SIZE;
+#else
+	const char* file_name = "frames.ids";
+	dump_header_size = 0;
+	dump_frame_size = sizeof(dump_scratch_ids[0]) * (size_t)SIZE;
+	//Devices read back to the dump frame or to scratch buffer
+	dump_scratch_ids = malloc(dump_frame_size);
+	for (int i = 0; i < num_of_cldevices; i++){
+		free(cl_devices[i].pixel_ids);
+		cl_devices[i].pixel_ids = dump_scratch_ids + cl_devices[i].global_start_y;
+	}
+#endif
+	dump_file = open(file_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (dump_file < 0){
+		perror("Frame dump open");
+		exit(1);
+	}
+	//First frame is mapped here so that it is never dropped
+	mapDumpSlot(0);
+	dump_prepared = 1;
+	if (pthread_create(&dump_thread, NULL, dumpWriter, NULL) != 0){
+		fprintf(stderr, "Frame dump thread creation failed\n");
+		exit(1);
+	}
+	fprintf(stdout, "Dumping frames to %s\n", file_name);
+}
+
+#if FRAME_DUMP == DUMP_IDS
+//Points read back of all devices to the next dump frame before rendering
+void beginDumpFrame(){
+	dump_ids = (void*)acquireDumpFrame();
+	for (int i = 0; i < num_of_cldevices; i++){
+		cl_devices[i].pixel_ids = (dump_ids != NULL ? dump_ids : dump_scratch_ids) + cl_devices[i].global_start_y;
+	}
+}
+#endif
+
+//Hands the rendered frame to writer
+void endDumpFrame(){
+#if FRAME_DUMP == DUMP_PIXELS
+	uint8_t* frame = acquireDumpFrame();
+	if (frame == NULL){
+		return;
+	}
+	memcpy(frame, dump_header, dump_header_size);
+	uint8_t* rgb = frame + dump_header_size;
+	#pragma omp parallel for
+	for (int y = 0; y < WINDOW_HEIGHT; y++){
+		pixel_color* row = pixels + (WINDOW_HEIGHT - 1 - y) * WINDOW_WIDTH;
+		uint8_t* out = rgb + 3 * y * WINDOW_WIDTH;
+		for (int x = 0; x < WINDOW_WIDTH; x++){
+		#if RGBA8_FRAMEBUFFER
+			out[3 * x] = row[x].red;
+			out[3 * x + 1] = row[x].green;
+			out[3 * x + 2] = row[x].blue;
+		#else
+			out[3 * x] = (uint8_t)(row[x].red * 255.0f + 0.5f);
+			out[3 * x + 1] = (uint8_t)(row[x].green * 255.0f + 0.5f);
+			out[3 * x + 2] = (uint8_t)(row[x].blue * 255.0f + 0.5f);
+		#endif
+		}
+	}
+	publishDumpFrame();
+#else
+	if (dump_ids != NULL){
+		publishDumpFrame();
+	}
+#endif
+}
+
+void stopFrameDump(){
+	__atomic_store_n(&dump_stop, 1, __ATOMIC_RELEASE);
+	pthread_join(dump_thread, NULL);
+	close(dump_file);
+	printf("Frame dump: %lu frames written, %lu dropped\n", dump_written, dump_dropped);
+#if FRAME_DUMP == DUMP_IDS
+	free(dump_scratch_ids);
+#endif
+}
+#endif
+
 // ## You may add your own initialization routines here ##
 void init(){
 
@@ -356,6 +1060,21 @@ void init(){
 	source_size = fread( source_str, 1, MAX_SOURCE_SIZE, fp);
 	fclose( fp );
 	
+#if GRAVITY_FIELD
+	attractors = (attractor*)malloc(sizeof(attractor) * ATTRACTOR_COUNT);
+	attractors[0].x = HORIZONTAL_CENTER;
+	attractors[0].y = VERTICAL_CENTER;
+	attractors[0].gravity = GRAVITY;
+	double ring_step = 2.0 * acos(-1.0) / (ATTRACTOR_COUNT > 1 ? ATTRACTOR_COUNT - 1 : 1);
+	for (int a = 1; a < ATTRACTOR_COUNT; a++){
+		attractors[a].x = HORIZONTAL_CENTER + ATTRACTOR_RING * cos(ring_step * a);
+		attractors[a].y = VERTICAL_CENTER + ATTRACTOR_RING * sin(ring_step * a);
+		attractors[a].gravity = ATTRACTOR_GRAVITY;
+	}
+	gravity_field = (float*)malloc(sizeof(float) * 2 * FIELD_COLUMNS * FIELD_ROWS);
+	buildGravityField();
+#endif
+	
 	//Allocate memory for possible CL devices
 	cl_devices = (ClDevice*) malloc(sizeof(ClDevice)*MAX_CL_DEVICES);
 
@@ -364,6 +1083,13 @@ void init(){
 
 	cl_int ret = CL_SUCCESS;
 	
+#if PALETTE_DISPLAY
+	#if SATELITE_COUNT < 255
+	owner_ids = (uint8_t*)malloc(sizeof(uint8_t) * SIZE);
+	#else
+	owner_ids = (int*)malloc(sizeof(int) * SIZE);
+	#endif
+#endif
 	//Share workload between available devices
 	for (int i=0;i<found_devices;i++){
 		
@@ -425,6 +1151,10 @@ void init(){
 		fprintf(stdout, "cl_devices[i].pixel_arr_size = %d\n",cl_devices[i].pixel_arr_size);
 		fprintf(stdout, "cl_devices[i].global_size = %ld\n",cl_devices[i].global_size);
 		fprintf(stdout, "cl_devices[i].local_size =%ld\n",cl_devices[i].local_size);
+	#if PALETTE_DISPLAY
+		free(cl_devices[i].pixel_ids);
+		cl_devices[i].pixel_ids = owner_ids + cl_devices[i].global_start_y;
+	#endif
 		
 		
 		// Create an OpenCL context
@@ -438,7 +1168,21 @@ void init(){
 		
 		fprintf(stdout, "Creating OpenCL buffers\n");
 		
+	#if DEVICE_PHYSICS
+		cl_devices[i].satelite_data_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,  SATELITE_COUNT * sizeof(satelite), satelites, &ret);
+	#if GRAVITY_FIELD
+		cl_image_format field_format = {.image_channel_order = CL_RG, .image_channel_data_type = CL_FLOAT};
+		cl_image_desc field_desc;
+		memset(&field_desc, 0, sizeof(field_desc));
+		field_desc.image_type = CL_MEM_OBJECT_IMAGE2D;
+		field_desc.image_width = FIELD_COLUMNS;
+		field_desc.image_height = FIELD_ROWS;
+		cl_devices[i].field_image = clCreateImage(cl_devices[i].context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, &field_format, &field_desc, gravity_field, &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateImage field_image\n",__LINE__);
+	#endif
+	#else
 		cl_devices[i].satelite_data_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_ONLY,  SATELITE_COUNT * sizeof(satelite), NULL, &ret);
+	#endif
 		checkAndHandleErr(ret, i, "ERROR clCreateBuffer satelite_data_gpu\n",__LINE__);
 		fprintf(stdout, "satelite_data_gpu size:%ld\n",SATELITE_COUNT * sizeof(satelite));
 		fprintf(stdout, "satelite_data_gpu id:%ld\n",(long)cl_devices[i].satelite_data_gpu);
@@ -462,6 +1206,18 @@ void init(){
 		cl_devices[i].program = clCreateProgramWithSource(cl_devices[i].context, 1, (const char **)&source_str, (const size_t *)&source_size, &ret);
 		checkAndHandleErr(ret, i, "ERROR clCreateProgramWithSource\n",__LINE__);
 
+	#if DEVICE_PHYSICS
+		//Devices keep equal satelites only if -cl-fp32-correctly-rounded-divide-sqrt is honoured,
+		//which is allowed only when the device reports correctly rounded divide and sqrt
+		cl_device_fp_config fp_config = 0;
+		ret = clGetDeviceInfo(cl_devices[i].device_id, CL_DEVICE_SINGLE_FP_CONFIG, sizeof(cl_device_fp_config), &fp_config, NULL);
+		checkAndHandleErr(ret, i, "ERROR clGetDeviceInfo CL_DEVICE_SINGLE_FP_CONFIG\n", __LINE__);
+		if (!(fp_config & CL_FP_CORRECTLY_ROUNDED_DIVIDE_SQRT)){
+			fprintf(stderr, "Device %d does not support correctly rounded float divide and sqrt, its physics would differ from host and other devices. Build with DEVICE_PHYSICS 0 to move satelites on host.\n", i);
+			exit(1);
+		}
+	#endif
+		
 		// Build the program
 		char *opts = CL_OPTIONS;
 		printf("CL-kernel options: %s\n", CL_OPTIONS);
@@ -491,20 +1247,973 @@ void init(){
 		fprintf(stdout, "cl_devices[i].global_start_y:%d\n\n\n",cl_devices[i].global_start_y);
 		ret = clEnqueueWriteBuffer(cl_devices[i].command_queue, cl_devices[i].pixel_start_offset_y, CL_TRUE, 0, sizeof(int), &cl_devices[i].global_start_y, 0, NULL, NULL);
 		checkAndHandleErr(ret, i, "ERROR clEnqueueWriteBuffer\n", __LINE__);
+		
+	#if DEVICE_PHYSICS
+	#if GRAVITY_FIELD
+		cl_devices[i].integrate_kernel = clCreateKernel(cl_devices[i].program, "integrate_field", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel integrate_field\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].integrate_kernel, 2, sizeof(cl_mem), (void *)&cl_devices[i].field_image);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg integrate_field 2\n", __LINE__);
+	#else
+		cl_devices[i].integrate_kernel = clCreateKernel(cl_devices[i].program, "integrate", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel integrate\n", __LINE__);
+	#endif
+		ret = clSetKernelArg(cl_devices[i].integrate_kernel, 0, sizeof(cl_mem), (void *)&cl_devices[i].satelite_data_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg integrate 0\n", __LINE__);
+	#endif
+		
+	#if RENDER_MODE == BRUTE_FORCE || RENDER_MODE == JUMP_FLOOD
+		cl_devices[i].disk_kernel = clCreateKernel(cl_devices[i].program, "stamp_disks", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel stamp_disks\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].disk_kernel, 0, sizeof(cl_mem), (void *)&cl_devices[i].satelite_data_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg stamp_disks 0\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].disk_kernel, 1, sizeof(cl_mem), (void *)&cl_devices[i].satelite_id_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg stamp_disks 1\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].disk_kernel, 2, sizeof(cl_mem), (void *)&cl_devices[i].pixel_start_offset_y);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg stamp_disks 2\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].disk_kernel, 3, sizeof(int), (void *)&cl_devices[i].pixel_arr_size);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg stamp_disks 3\n", __LINE__);
+	#endif
+	
+	#if RENDER_MODE == JUMP_FLOOD
+		fprintf(stdout, "Creating jump flooding buffers and kernels\n");
+		
+		//Flooding needs whole window on every device, resolve writes only device share
+		for (int b = 0; b < 2; b++){
+			cl_devices[i].owner_gpu[b] = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_WRITE, sizeof(int)*SIZE, NULL, &ret);
+			checkAndHandleErr(ret, i, "ERROR clCreateBuffer owner_gpu\n",__LINE__);
+		}
+		
+		cl_devices[i].jfa_clear_kernel = clCreateKernel(cl_devices[i].program, "jfa_clear", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel jfa_clear\n", __LINE__);
+		cl_devices[i].jfa_seed_kernel = clCreateKernel(cl_devices[i].program, "jfa_seed", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel jfa_seed\n", __LINE__);
+		cl_devices[i].jfa_reseed_kernel = clCreateKernel(cl_devices[i].program, "jfa_reseed", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel jfa_reseed\n", __LINE__);
+		cl_devices[i].jfa_step_kernel = clCreateKernel(cl_devices[i].program, "jfa_step", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel jfa_step\n", __LINE__);
+		cl_devices[i].jfa_refine_kernel = clCreateKernel(cl_devices[i].program, "jfa_refine", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel jfa_refine\n", __LINE__);
+		cl_devices[i].jfa_resolve_kernel = clCreateKernel(cl_devices[i].program, "jfa_resolve", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel jfa_resolve\n", __LINE__);
+		
+		ret = clSetKernelArg(cl_devices[i].jfa_clear_kernel, 0, sizeof(cl_mem), (void *)&cl_devices[i].owner_gpu[0]);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg jfa_clear 0\n", __LINE__);
+		
+		ret = clSetKernelArg(cl_devices[i].jfa_seed_kernel, 0, sizeof(cl_mem), (void *)&cl_devices[i].satelite_data_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg jfa_seed 0\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].jfa_seed_kernel, 1, sizeof(cl_mem), (void *)&cl_devices[i].owner_gpu[0]);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg jfa_seed 1\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].jfa_reseed_kernel, 0, sizeof(cl_mem), (void *)&cl_devices[i].satelite_data_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg jfa_reseed 0\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].jfa_reseed_kernel, 1, sizeof(cl_mem), (void *)&cl_devices[i].owner_gpu[0]);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg jfa_reseed 1\n", __LINE__);
+		
+		//Owner buffers of the step kernel are swapped on every pass
+		ret = clSetKernelArg(cl_devices[i].jfa_step_kernel, 0, sizeof(cl_mem), (void *)&cl_devices[i].satelite_data_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg jfa_step 0\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].jfa_refine_kernel, 0, sizeof(cl_mem), (void *)&cl_devices[i].satelite_data_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg jfa_refine 0\n", __LINE__);
+		
+		ret = clSetKernelArg(cl_devices[i].jfa_resolve_kernel, 1, sizeof(cl_mem), (void *)&cl_devices[i].satelite_id_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg jfa_resolve 1\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].jfa_resolve_kernel, 2, sizeof(cl_mem), (void *)&cl_devices[i].pixel_start_offset_y);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg jfa_resolve 2\n", __LINE__);
+	#endif
+	
+	#if RENDER_MODE == BLOCK_FILL
+		//Tiles are aligned to rows, so device shares must start at row boundary
+		if (cl_devices[i].global_start_y % WINDOW_WIDTH != 0 || cl_devices[i].pixel_arr_size % WINDOW_WIDTH != 0){
+			fprintf(stderr, "Block fill needs device shares of whole rows\n");
+			exit(1);
+		}
+		int share_rows = cl_devices[i].pixel_arr_size / WINDOW_WIDTH;
+		cl_devices[i].block_global_size = ((WINDOW_WIDTH + FILL_TILE - 1) / FILL_TILE) * ((share_rows + FILL_TILE - 1) / FILL_TILE);
+		
+		cl_devices[i].block_kernel = clCreateKernel(cl_devices[i].program, "render_blocks", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel render_blocks\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].block_kernel, 0, sizeof(cl_mem), (void *)&cl_devices[i].satelite_data_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_blocks 0\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].block_kernel, 1, sizeof(cl_mem), (void *)&cl_devices[i].satelite_id_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_blocks 1\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].block_kernel, 2, sizeof(cl_mem), (void *)&cl_devices[i].pixel_start_offset_y);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_blocks 2\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].block_kernel, 3, sizeof(int), (void *)&share_rows);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_blocks 3\n", __LINE__);
+	#endif
+	
+	#if RENDER_MODE == TILE_BINNING
+		//Candidate buffer grows when needed, start with one candidate per tile
+		cl_devices[i].tile_candidates_size = TILE_COUNT;
+		cl_devices[i].tile_start_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_ONLY, sizeof(int) * (TILE_COUNT + 1), NULL, &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateBuffer tile_start_gpu\n",__LINE__);
+		cl_devices[i].tile_candidates_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_ONLY, sizeof(int) * cl_devices[i].tile_candidates_size, NULL, &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateBuffer tile_candidates_gpu\n",__LINE__);
+		
+		cl_devices[i].tile_kernel = clCreateKernel(cl_devices[i].program, "render_tiles", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel render_tiles\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].tile_kernel, 0, sizeof(cl_mem), (void *)&cl_devices[i].satelite_data_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_tiles 0\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].tile_kernel, 1, sizeof(cl_mem), (void *)&cl_devices[i].tile_start_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_tiles 1\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].tile_kernel, 2, sizeof(cl_mem), (void *)&cl_devices[i].tile_candidates_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_tiles 2\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].tile_kernel, 3, sizeof(cl_mem), (void *)&cl_devices[i].satelite_id_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_tiles 3\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].tile_kernel, 4, sizeof(cl_mem), (void *)&cl_devices[i].pixel_start_offset_y);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_tiles 4\n", __LINE__);
+	#endif
+	
+	#if RENDER_MODE == TEMPORAL_COHERENCE
+		//Contents are garbage until first frame, which does the full search for all pixels
+		cl_devices[i].last_owner_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_WRITE, sizeof(int) * cl_devices[i].pixel_arr_size, NULL, &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateBuffer last_owner_gpu\n",__LINE__);
+		cl_devices[i].last_margin_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_WRITE, sizeof(float) * cl_devices[i].pixel_arr_size, NULL, &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateBuffer last_margin_gpu\n",__LINE__);
+		
+		cl_devices[i].coherent_kernel = clCreateKernel(cl_devices[i].program, "render_coherent", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel render_coherent\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].coherent_kernel, 0, sizeof(cl_mem), (void *)&cl_devices[i].satelite_data_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_coherent 0\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].coherent_kernel, 1, sizeof(cl_mem), (void *)&cl_devices[i].last_owner_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_coherent 1\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].coherent_kernel, 2, sizeof(cl_mem), (void *)&cl_devices[i].last_margin_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_coherent 2\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].coherent_kernel, 3, sizeof(cl_mem), (void *)&cl_devices[i].satelite_id_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_coherent 3\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].coherent_kernel, 4, sizeof(cl_mem), (void *)&cl_devices[i].pixel_start_offset_y);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_coherent 4\n", __LINE__);
+	#endif
+	
+	#if RENDER_MODE == DIRTY_REGION
+		//Contents are garbage until first frame, which recomputes and sends all pixels
+		cl_devices[i].last_owner_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_WRITE, sizeof(int) * cl_devices[i].pixel_arr_size, NULL, &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateBuffer last_owner_gpu\n",__LINE__);
+		cl_devices[i].last_margin_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_WRITE, sizeof(float) * cl_devices[i].pixel_arr_size, NULL, &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateBuffer last_margin_gpu\n",__LINE__);
+		cl_devices[i].last_disk_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_WRITE, sizeof(float) * cl_devices[i].pixel_arr_size, NULL, &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateBuffer last_disk_gpu\n",__LINE__);
+		cl_devices[i].dirty_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_WRITE_ONLY, sizeof(dirty_entry) * cl_devices[i].pixel_arr_size, NULL, &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateBuffer dirty_gpu\n",__LINE__);
+		cl_devices[i].dirty_count_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_WRITE, sizeof(int), NULL, &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateBuffer dirty_count_gpu\n",__LINE__);
+		cl_devices[i].dirty = (dirty_entry*)malloc(sizeof(dirty_entry) * cl_devices[i].pixel_arr_size);
+		
+		cl_devices[i].dirty_kernel = clCreateKernel(cl_devices[i].program, "render_dirty", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel render_dirty\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].dirty_kernel, 0, sizeof(cl_mem), (void *)&cl_devices[i].satelite_data_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_dirty 0\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].dirty_kernel, 1, sizeof(cl_mem), (void *)&cl_devices[i].last_owner_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_dirty 1\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].dirty_kernel, 2, sizeof(cl_mem), (void *)&cl_devices[i].last_margin_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_dirty 2\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].dirty_kernel, 3, sizeof(cl_mem), (void *)&cl_devices[i].last_disk_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_dirty 3\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].dirty_kernel, 4, sizeof(cl_mem), (void *)&cl_devices[i].dirty_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_dirty 4\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].dirty_kernel, 5, sizeof(cl_mem), (void *)&cl_devices[i].dirty_count_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_dirty 5\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].dirty_kernel, 6, sizeof(cl_mem), (void *)&cl_devices[i].pixel_start_offset_y);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_dirty 6\n", __LINE__);
+	#endif
+	
+	#if RLE_READBACK
+		//Rows are encoded separately, so device shares must be whole rows
+		if (cl_devices[i].global_start_y % WINDOW_WIDTH != 0 || cl_devices[i].pixel_arr_size % WINDOW_WIDTH != 0){
+			fprintf(stderr, "Run length readback needs device shares of whole rows\n");
+			exit(1);
+		}
+		cl_devices[i].share_rows = cl_devices[i].pixel_arr_size / WINDOW_WIDTH;
+		cl_devices[i].row_runs_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_WRITE, sizeof(int) * cl_devices[i].share_rows, NULL, &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateBuffer row_runs_gpu\n",__LINE__);
+		cl_devices[i].row_offsets_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_WRITE, sizeof(int) * (cl_devices[i].share_rows + 1), NULL, &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateBuffer row_offsets_gpu\n",__LINE__);
+		//Every pixel can be its own run
+		cl_devices[i].runs_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_WRITE_ONLY, sizeof(cl_uint) * cl_devices[i].pixel_arr_size, NULL, &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateBuffer runs_gpu\n",__LINE__);
+		cl_devices[i].row_offsets = (int*)malloc(sizeof(int) * (cl_devices[i].share_rows + 1));
+		cl_devices[i].runs = (cl_uint*)malloc(sizeof(cl_uint) * cl_devices[i].pixel_arr_size);
+		
+		cl_devices[i].rle_count_kernel = clCreateKernel(cl_devices[i].program, "rle_count", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel rle_count\n", __LINE__);
+		cl_devices[i].rle_offsets_kernel = clCreateKernel(cl_devices[i].program, "rle_offsets", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel rle_offsets\n", __LINE__);
+		cl_devices[i].rle_write_kernel = clCreateKernel(cl_devices[i].program, "rle_write", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel rle_write\n", __LINE__);
+		
+		ret = clSetKernelArg(cl_devices[i].rle_count_kernel, 0, sizeof(cl_mem), (void *)&cl_devices[i].satelite_id_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg rle_count 0\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].rle_count_kernel, 1, sizeof(cl_mem), (void *)&cl_devices[i].row_runs_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg rle_count 1\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].rle_offsets_kernel, 0, sizeof(cl_mem), (void *)&cl_devices[i].row_runs_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg rle_offsets 0\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].rle_offsets_kernel, 1, sizeof(cl_mem), (void *)&cl_devices[i].row_offsets_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg rle_offsets 1\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].rle_offsets_kernel, 2, sizeof(int), (void *)&cl_devices[i].share_rows);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg rle_offsets 2\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].rle_write_kernel, 0, sizeof(cl_mem), (void *)&cl_devices[i].satelite_id_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg rle_write 0\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].rle_write_kernel, 1, sizeof(cl_mem), (void *)&cl_devices[i].row_offsets_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg rle_write 1\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].rle_write_kernel, 2, sizeof(cl_mem), (void *)&cl_devices[i].runs_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg rle_write 2\n", __LINE__);
+	#endif
+	
+	#if DELTA_READBACK
+		#if SATELITE_COUNT < 255
+		cl_devices[i].previous_ids_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_WRITE, sizeof(uint8_t) * cl_devices[i].pixel_arr_size, NULL, &ret);
+		#else
+		cl_devices[i].previous_ids_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_WRITE, sizeof(int) * cl_devices[i].pixel_arr_size, NULL, &ret);
+		#endif
+		checkAndHandleErr(ret, i, "ERROR clCreateBuffer previous_ids_gpu\n",__LINE__);
+		cl_devices[i].delta_flags_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_WRITE, sizeof(int) * cl_devices[i].pixel_arr_size, NULL, &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateBuffer delta_flags_gpu\n",__LINE__);
+		cl_devices[i].delta_offsets_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_WRITE, sizeof(int) * cl_devices[i].pixel_arr_size, NULL, &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateBuffer delta_offsets_gpu\n",__LINE__);
+		cl_devices[i].dirty_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_WRITE_ONLY, sizeof(dirty_entry) * cl_devices[i].pixel_arr_size, NULL, &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateBuffer dirty_gpu\n",__LINE__);
+		cl_devices[i].dirty_count_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_WRITE, sizeof(int), NULL, &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateBuffer dirty_count_gpu\n",__LINE__);
+		cl_devices[i].dirty = (dirty_entry*)malloc(sizeof(dirty_entry) * cl_devices[i].pixel_arr_size);
+		cl_devices[i].delta_all_changed = 1;
+		
+		//Every scan level has one total per block of the level below
+		int scan_items = cl_devices[i].pixel_arr_size;
+		for (int level = 0; level < SCAN_LEVELS; level++){
+			int blocks = (scan_items + SCAN_GROUP - 1) / SCAN_GROUP;
+			cl_devices[i].scan_sums_gpu[level] = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_WRITE, sizeof(int) * blocks, NULL, &ret);
+			checkAndHandleErr(ret, i, "ERROR clCreateBuffer scan_sums_gpu\n",__LINE__);
+			cl_devices[i].scan_offsets_gpu[level] = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_WRITE, sizeof(int) * blocks, NULL, &ret);
+			checkAndHandleErr(ret, i, "ERROR clCreateBuffer scan_offsets_gpu\n",__LINE__);
+			scan_items = blocks;
+		}
+		if (scan_items > 1){
+			fprintf(stderr, "Device share is too large for SCAN_LEVELS\n");
+			exit(1);
+		}
+		
+		cl_devices[i].delta_flags_kernel = clCreateKernel(cl_devices[i].program, "delta_flags", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel delta_flags\n", __LINE__);
+		cl_devices[i].delta_scatter_kernel = clCreateKernel(cl_devices[i].program, "delta_scatter", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel delta_scatter\n", __LINE__);
+		cl_devices[i].scan_blocks_kernel = clCreateKernel(cl_devices[i].program, "scan_blocks", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel scan_blocks\n", __LINE__);
+		cl_devices[i].scan_add_kernel = clCreateKernel(cl_devices[i].program, "scan_add", &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateKernel scan_add\n", __LINE__);
+		
+		ret = clSetKernelArg(cl_devices[i].delta_flags_kernel, 0, sizeof(cl_mem), (void *)&cl_devices[i].satelite_id_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg delta_flags 0\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].delta_flags_kernel, 1, sizeof(cl_mem), (void *)&cl_devices[i].previous_ids_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg delta_flags 1\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].delta_flags_kernel, 2, sizeof(cl_mem), (void *)&cl_devices[i].delta_flags_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg delta_flags 2\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].delta_scatter_kernel, 0, sizeof(cl_mem), (void *)&cl_devices[i].satelite_id_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg delta_scatter 0\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].delta_scatter_kernel, 1, sizeof(cl_mem), (void *)&cl_devices[i].previous_ids_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg delta_scatter 1\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].delta_scatter_kernel, 2, sizeof(cl_mem), (void *)&cl_devices[i].delta_flags_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg delta_scatter 2\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].delta_scatter_kernel, 3, sizeof(cl_mem), (void *)&cl_devices[i].delta_offsets_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg delta_scatter 3\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].delta_scatter_kernel, 4, sizeof(cl_mem), (void *)&cl_devices[i].dirty_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg delta_scatter 4\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].delta_scatter_kernel, 5, sizeof(cl_mem), (void *)&cl_devices[i].dirty_count_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg delta_scatter 5\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].delta_scatter_kernel, 6, sizeof(int), (void *)&cl_devices[i].pixel_arr_size);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg delta_scatter 6\n", __LINE__);
+	#endif
 	}
+	
+#if RENDER_MODE == TILE_BINNING
+	tile_start = (int*)malloc(sizeof(int) * (TILE_COUNT + 1));
+	tile_bound = (float*)malloc(sizeof(float) * TILE_COUNT);
+	tile_candidates_capacity = TILE_COUNT;
+	tile_candidates = (int*)malloc(sizeof(int) * tile_candidates_capacity);
+#endif
+	satelite_displacement = (double*)calloc(SATELITE_COUNT, sizeof(double));
+#if INTEGRATOR == ADAPTIVE_RK
+	integrator_step = (double*)calloc(SATELITE_COUNT, sizeof(double));
+#endif
+#if SIMD_PHYSICS
+	physics_position_x = (float*)_mm_malloc(sizeof(float) * PHYSICS_LANE_CAPACITY, 64);
+	physics_position_y = (float*)_mm_malloc(sizeof(float) * PHYSICS_LANE_CAPACITY, 64);
+	physics_velocity_x = (float*)_mm_malloc(sizeof(float) * PHYSICS_LANE_CAPACITY, 64);
+	physics_velocity_y = (float*)_mm_malloc(sizeof(float) * PHYSICS_LANE_CAPACITY, 64);
+	selectSimdIntegrate();
+#endif
+	satelite_colors = (pixel_color*)malloc(sizeof(pixel_color) * SATELITE_COUNT);
+	for (int j = 0; j < SATELITE_COUNT; j++){
+		satelite_colors[j] = toPixelColor(satelites[j].identifier);
+	}
+	color white = {.red = 1.0f, .green= 1.0f, .blue=1.0f};
+	white_color = toPixelColor(white);
+#if PALETTE_DISPLAY
+	initPaletteDisplay();
+#endif
+#if PBO_DISPLAY
+	initPixelBuffers();
+#endif
+#if FRAME_DUMP
+	startFrameDump();
+#endif
 	fprintf(stdout, "init ends\n");
 }
 
 
+#if RENDER_MODE == JUMP_FLOOD
+/*
+	Enqueues jump flooding passes for one device. Queue is in-order so passes
+	are serialized without events, event of the last kernel is stored to evnt
+*/
+void enqueueJumpFlood(int i){
+	cl_int ret = CL_SUCCESS;
+	size_t window_size = SIZE;
+	size_t satelite_count = SATELITE_COUNT;
+	
+	ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].jfa_clear_kernel, 1, NULL, &window_size, &cl_devices[i].local_size, 0, NULL, NULL);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel jfa_clear\n", __LINE__);
+	ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].jfa_seed_kernel, 1, NULL, &satelite_count, NULL, 0, NULL, NULL);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel jfa_seed\n", __LINE__);
+	ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].jfa_reseed_kernel, 1, NULL, &satelite_count, NULL, 0, NULL, NULL);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel jfa_reseed\n", __LINE__);
+	
+	//Largest step is half of the next power of two, extra step 2 and 1 passes fix most flooding errors
+	int max_dim = WINDOW_WIDTH > WINDOW_HEIGHT ? WINDOW_WIDTH : WINDOW_HEIGHT;
+	int passes[32];
+	int pass_count = 0;
+	int first_step = 1;
+	while (first_step < max_dim){
+		first_step <<= 1;
+	}
+	for (int step = first_step >> 1; step >= 1; step >>= 1){
+		passes[pass_count++] = step;
+	}
+	passes[pass_count++] = 2;
+	passes[pass_count++] = 1;
+	
+	int src = 0;
+	for (int pass = 0; pass < pass_count; pass++){
+		ret = clSetKernelArg(cl_devices[i].jfa_step_kernel, 1, sizeof(cl_mem), (void *)&cl_devices[i].owner_gpu[src]);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg jfa_step 1\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].jfa_step_kernel, 2, sizeof(cl_mem), (void *)&cl_devices[i].owner_gpu[1 - src]);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg jfa_step 2\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].jfa_step_kernel, 3, sizeof(int), (void *)&passes[pass]);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg jfa_step 3\n", __LINE__);
+		ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].jfa_step_kernel, 1, NULL, &window_size, &cl_devices[i].local_size, 0, NULL, NULL);
+		checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel jfa_step\n", __LINE__);
+		src = 1 - src;
+	}
+	
+	//Pixels next to a different owner are checked against all satelites
+	ret = clSetKernelArg(cl_devices[i].jfa_refine_kernel, 1, sizeof(cl_mem), (void *)&cl_devices[i].owner_gpu[src]);
+	checkAndHandleErr(ret, i, "ERROR clSetKernelArg jfa_refine 1\n", __LINE__);
+	ret = clSetKernelArg(cl_devices[i].jfa_refine_kernel, 2, sizeof(cl_mem), (void *)&cl_devices[i].owner_gpu[1 - src]);
+	checkAndHandleErr(ret, i, "ERROR clSetKernelArg jfa_refine 2\n", __LINE__);
+	ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].jfa_refine_kernel, 1, NULL, &window_size, &cl_devices[i].local_size, 0, NULL, NULL);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel jfa_refine\n", __LINE__);
+	src = 1 - src;
+	
+	size_t share_size = cl_devices[i].pixel_arr_size;
+	ret = clSetKernelArg(cl_devices[i].jfa_resolve_kernel, 0, sizeof(cl_mem), (void *)&cl_devices[i].owner_gpu[src]);
+	checkAndHandleErr(ret, i, "ERROR clSetKernelArg jfa_resolve 0\n", __LINE__);
+	ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].jfa_resolve_kernel, 1, NULL, &share_size, &cl_devices[i].local_size, 0, NULL, NULL);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel jfa_resolve\n", __LINE__);
+	
+	//Disks are tested against every satelite, not only the flooded owner
+	size_t disk_items = SATELITE_COUNT * DISK_SPAN * DISK_SPAN;
+	ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].disk_kernel, 1, NULL, &disk_items, NULL, 0, NULL, &cl_devices[i].evnt);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel stamp_disks\n", __LINE__);
+}
+#endif
+
+#if RENDER_MODE == TILE_BINNING
+/*
+	Builds candidate lists of all tiles from current satelite positions.
+	Any pixel p of a tile is at most h (half diagonal) from tile center c,
+	so its owner k satisfies |p-k| <= |p-n| <= |c-n| + h where n is the
+	satelite closest to c. That gives |c-k| <= |c-n| + 2h for all owners.
+	Closest satelite of every pixel is in the list, so disks are exact too.
+*/
+void binSatelitesToTiles(){
+	const float half_diagonal = sqrt(2.0f) * (BIN_TILE - 1) / 2.0f;
+	
+	#pragma omp parallel for
+	for (int t = 0; t < TILE_COUNT; t++){
+		float cx = t % TILES_IN_ROW * BIN_TILE + (BIN_TILE - 1) / 2.0f;
+		float cy = t / TILES_IN_ROW * BIN_TILE + (BIN_TILE - 1) / 2.0f;
+		
+		float nearest = INFINITY;
+		for (int j = 0; j < SATELITE_COUNT; j++){
+			float dx = cx - satelites[j].position.x;
+			float dy = cy - satelites[j].position.y;
+			float dist = dx * dx + dy * dy;
+			if (dist < nearest){
+				nearest = dist;
+			}
+		}
+		
+		//One extra pixel of slack for float rounding
+		float bound = sqrt(nearest) + 2.0f * half_diagonal + 1.0f;
+		tile_bound[t] = bound * bound;
+		
+		int count = 0;
+		for (int j = 0; j < SATELITE_COUNT; j++){
+			float dx = cx - satelites[j].position.x;
+			float dy = cy - satelites[j].position.y;
+			if (dx * dx + dy * dy <= tile_bound[t]){
+				count++;
+			}
+		}
+		tile_start[t + 1] = count;
+	}
+	
+	tile_start[0] = 0;
+	for (int t = 0; t < TILE_COUNT; t++){
+		tile_start[t + 1] += tile_start[t];
+	}
+	if (tile_start[TILE_COUNT] > tile_candidates_capacity){
+		while (tile_candidates_capacity < tile_start[TILE_COUNT]){
+			tile_candidates_capacity *= 2;
+		}
+		tile_candidates = (int*)realloc(tile_candidates, sizeof(int) * tile_candidates_capacity);
+	}
+	
+	#pragma omp parallel for
+	for (int t = 0; t < TILE_COUNT; t++){
+		float cx = t % TILES_IN_ROW * BIN_TILE + (BIN_TILE - 1) / 2.0f;
+		float cy = t / TILES_IN_ROW * BIN_TILE + (BIN_TILE - 1) / 2.0f;
+		int c = tile_start[t];
+		for (int j = 0; j < SATELITE_COUNT; j++){
+			float dx = cx - satelites[j].position.x;
+			float dy = cy - satelites[j].position.y;
+			if (dx * dx + dy * dy <= tile_bound[t]){
+				tile_candidates[c++] = j;
+			}
+		}
+	}
+}
+
+/*
+	Uploads candidate lists to one device, candidate buffer is recreated if it is too small
+*/
+void uploadTileCandidates(int i){
+	cl_int ret = CL_SUCCESS;
+	int candidates = tile_start[TILE_COUNT];
+	if (candidates > cl_devices[i].tile_candidates_size){
+		clReleaseMemObject(cl_devices[i].tile_candidates_gpu);
+		cl_devices[i].tile_candidates_size = tile_candidates_capacity;
+		cl_devices[i].tile_candidates_gpu = clCreateBuffer(cl_devices[i].context, CL_MEM_READ_ONLY, sizeof(int) * cl_devices[i].tile_candidates_size, NULL, &ret);
+		checkAndHandleErr(ret, i, "ERROR clCreateBuffer tile_candidates_gpu\n",__LINE__);
+		ret = clSetKernelArg(cl_devices[i].tile_kernel, 2, sizeof(cl_mem), (void *)&cl_devices[i].tile_candidates_gpu);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_tiles 2\n", __LINE__);
+	}
+	ret = clEnqueueWriteBuffer(cl_devices[i].command_queue, cl_devices[i].tile_start_gpu, CL_TRUE, 0, sizeof(int) * (TILE_COUNT + 1), tile_start, 0, NULL, NULL);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueWriteBuffer tile_start_gpu\n", __LINE__);
+	ret = clEnqueueWriteBuffer(cl_devices[i].command_queue, cl_devices[i].tile_candidates_gpu, CL_TRUE, 0, sizeof(int) * candidates, tile_candidates, 0, NULL, NULL);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueWriteBuffer tile_candidates_gpu\n", __LINE__);
+}
+#endif
+
+#if RENDER_MODE == TEMPORAL_COHERENCE || RENDER_MODE == DIRTY_REGION
+/*
+	Longest distance any satelite moved in the last physics update, infinite
+	on first frame when device has no owners from previous frame
+*/
+float frameDisplacement(){
+	if (first_rendered_frame){
+		first_rendered_frame = 0;
+		return INFINITY;
+	}
+	double longest = 0.0;
+	for (int j = 0; j < SATELITE_COUNT; j++){
+		if (!(satelite_displacement[j] <= longest)){
+			longest = satelite_displacement[j]; //NaN positions also end up here
+		}
+	}
+	//Rounded up so that float never underestimates the movement
+	return (float)(longest * (1.0 + 1e-6)) + 1e-6f;
+}
+#endif
+
+#if RENDER_MODE == DIRTY_REGION || DELTA_READBACK
+/*
+	Reads back changed pixels of one device and recolors them, other pixels
+	keep the color of previous frame
+*/
+void applyChangedPixels(int i){
+	cl_int ret = CL_SUCCESS;
+	ret = clEnqueueReadBuffer(cl_devices[i].command_queue, cl_devices[i].dirty_count_gpu, CL_TRUE, 0, sizeof(int), &cl_devices[i].dirty_count, 0, NULL, NULL);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueReadBuffer dirty_count_gpu\n", __LINE__);
+	if (cl_devices[i].dirty_count == 0){
+		return;
+	}
+	ret = clEnqueueReadBuffer(cl_devices[i].command_queue, cl_devices[i].dirty_gpu, CL_TRUE, 0, sizeof(dirty_entry) * cl_devices[i].dirty_count, cl_devices[i].dirty, 0, NULL, NULL);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueReadBuffer dirty_gpu\n", __LINE__);
+	
+	int offset_start = cl_devices[i].global_start_y;
+	#pragma omp parallel for
+	for (int k = 0; k < cl_devices[i].dirty_count; k++){
+		int id = DIRTY_ENTRY_ID(cl_devices[i].dirty[k]);
+		pixels[offset_start + DIRTY_ENTRY_INDEX(cl_devices[i].dirty[k])] = id == DIRTY_WHITE ? white_color : satelite_colors[id];
+	}
+}
+#endif
+
+#if RENDER_MODE == DIRTY_REGION
+void readDirtyPixels(int i){
+	cl_int ret = clWaitForEvents(1, &cl_devices[i].evnt);
+	checkAndHandleErr(ret, i, "ERROR clWaitForEvents render_dirty\n", __LINE__);
+	clReleaseEvent(cl_devices[i].evnt);
+	applyChangedPixels(i);
+}
+#endif
+
+#if DELTA_READBACK
+/*
+	Enqueues exclusive scan of n ints from in to out. Block totals of every
+	level are scanned recursively and added back to the blocks.
+*/
+void enqueueScan(int i, cl_mem in, cl_mem out, int n, int level){
+	cl_int ret = CL_SUCCESS;
+	size_t blocks = (n + SCAN_GROUP - 1) / SCAN_GROUP;
+	size_t global_size = blocks * SCAN_GROUP;
+	size_t local_size = SCAN_GROUP;
+	
+	ret = clSetKernelArg(cl_devices[i].scan_blocks_kernel, 0, sizeof(cl_mem), (void *)&in);
+	checkAndHandleErr(ret, i, "ERROR clSetKernelArg scan_blocks 0\n", __LINE__);
+	ret = clSetKernelArg(cl_devices[i].scan_blocks_kernel, 1, sizeof(cl_mem), (void *)&out);
+	checkAndHandleErr(ret, i, "ERROR clSetKernelArg scan_blocks 1\n", __LINE__);
+	ret = clSetKernelArg(cl_devices[i].scan_blocks_kernel, 2, sizeof(cl_mem), (void *)&cl_devices[i].scan_sums_gpu[level]);
+	checkAndHandleErr(ret, i, "ERROR clSetKernelArg scan_blocks 2\n", __LINE__);
+	ret = clSetKernelArg(cl_devices[i].scan_blocks_kernel, 3, sizeof(int), (void *)&n);
+	checkAndHandleErr(ret, i, "ERROR clSetKernelArg scan_blocks 3\n", __LINE__);
+	ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].scan_blocks_kernel, 1, NULL, &global_size, &local_size, 0, NULL, NULL);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel scan_blocks\n", __LINE__);
+	if (blocks == 1){
+		return;
+	}
+	
+	enqueueScan(i, cl_devices[i].scan_sums_gpu[level], cl_devices[i].scan_offsets_gpu[level], blocks, level + 1);
+	ret = clSetKernelArg(cl_devices[i].scan_add_kernel, 0, sizeof(cl_mem), (void *)&out);
+	checkAndHandleErr(ret, i, "ERROR clSetKernelArg scan_add 0\n", __LINE__);
+	ret = clSetKernelArg(cl_devices[i].scan_add_kernel, 1, sizeof(cl_mem), (void *)&cl_devices[i].scan_offsets_gpu[level]);
+	checkAndHandleErr(ret, i, "ERROR clSetKernelArg scan_add 1\n", __LINE__);
+	ret = clSetKernelArg(cl_devices[i].scan_add_kernel, 2, sizeof(int), (void *)&n);
+	checkAndHandleErr(ret, i, "ERROR clSetKernelArg scan_add 2\n", __LINE__);
+	ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].scan_add_kernel, 1, NULL, &global_size, &local_size, 0, NULL, NULL);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel scan_add\n", __LINE__);
+}
+
+/*
+	Compares sat_ids of one device to previous frame after its render kernel,
+	compacts changed pixels with scan and applies them to pixels
+*/
+void readDeltaPixels(int i){
+	cl_int ret = CL_SUCCESS;
+	size_t share_size = cl_devices[i].pixel_arr_size;
+	ret = clWaitForEvents(1, &cl_devices[i].evnt);
+	checkAndHandleErr(ret, i, "ERROR clWaitForEvents\n", __LINE__);
+	clReleaseEvent(cl_devices[i].evnt);
+	
+	ret = clSetKernelArg(cl_devices[i].delta_flags_kernel, 3, sizeof(int), (void *)&cl_devices[i].delta_all_changed);
+	checkAndHandleErr(ret, i, "ERROR clSetKernelArg delta_flags 3\n", __LINE__);
+	ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].delta_flags_kernel, 1, NULL, &share_size, NULL, 0, NULL, NULL);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel delta_flags\n", __LINE__);
+	enqueueScan(i, cl_devices[i].delta_flags_gpu, cl_devices[i].delta_offsets_gpu, cl_devices[i].pixel_arr_size, 0);
+	ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].delta_scatter_kernel, 1, NULL, &share_size, NULL, 0, NULL, NULL);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel delta_scatter\n", __LINE__);
+	cl_devices[i].delta_all_changed = 0;
+	
+	applyChangedPixels(i);
+}
+#endif
+
+#if RLE_READBACK
+/*
+	Encodes rows of sat_ids to runs after render kernel of one device, reads
+	back row offsets and runs and expands them to pixels row by row
+*/
+void readRunLengthPixels(int i){
+	cl_int ret = CL_SUCCESS;
+	size_t rows = cl_devices[i].share_rows;
+	size_t one = 1;
+	ret = clWaitForEvents(1, &cl_devices[i].evnt);
+	checkAndHandleErr(ret, i, "ERROR clWaitForEvents\n", __LINE__);
+	clReleaseEvent(cl_devices[i].evnt);
+	
+	ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].rle_count_kernel, 1, NULL, &rows, NULL, 0, NULL, NULL);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel rle_count\n", __LINE__);
+	ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].rle_offsets_kernel, 1, NULL, &one, NULL, 0, NULL, NULL);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel rle_offsets\n", __LINE__);
+	ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].rle_write_kernel, 1, NULL, &rows, NULL, 0, NULL, NULL);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel rle_write\n", __LINE__);
+	
+	ret = clEnqueueReadBuffer(cl_devices[i].command_queue, cl_devices[i].row_offsets_gpu, CL_TRUE, 0, sizeof(int) * (rows + 1), cl_devices[i].row_offsets, 0, NULL, NULL);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueReadBuffer row_offsets_gpu\n", __LINE__);
+	ret = clEnqueueReadBuffer(cl_devices[i].command_queue, cl_devices[i].runs_gpu, CL_TRUE, 0, sizeof(cl_uint) * cl_devices[i].row_offsets[rows], cl_devices[i].runs, 0, NULL, NULL);
+	checkAndHandleErr(ret, i, "ERROR clEnqueueReadBuffer runs_gpu\n", __LINE__);
+	
+	#if SATELITE_COUNT < 255
+	const int white_id = 0xFF;
+	#else
+	const int white_id = 0xFFFF;
+	#endif
+	pixel_color* row_pixels = pixels + cl_devices[i].global_start_y;
+	#pragma omp parallel for
+	for (int r = 0; r < (int)rows; r++){
+		pixel_color* pixel = row_pixels + r * WINDOW_WIDTH;
+		for (int k = cl_devices[i].row_offsets[r]; k < cl_devices[i].row_offsets[r + 1]; k++){
+			int id = cl_devices[i].runs[k] >> 16;
+			int length = cl_devices[i].runs[k] & 0xFFFF;
+			pixel_color run_color = id == white_id ? white_color : satelite_colors[id];
+			for (int x = 0; x < length; x++){
+				pixel[x] = run_color;
+			}
+			pixel += length;
+		}
+	}
+}
+#endif
+
+#if GRAVITY_FIELD
+// Sums softened gravity of all attractors to every grid point once, after this the
+// integrate kernel costs the same for any number of attractors
+void buildGravityField(){
+	#pragma omp parallel for
+	for (int row = 0; row < FIELD_ROWS; row++){
+		double y = (double)row * FIELD_CELL - FIELD_MARGIN;
+		for (int column = 0; column < FIELD_COLUMNS; column++){
+			double x = (double)column * FIELD_CELL - FIELD_MARGIN;
+			double ax = 0.0;
+			double ay = 0.0;
+			for (int a = 0; a < ATTRACTOR_COUNT; a++){
+				double dx = attractors[a].x - x;
+				double dy = attractors[a].y - y;
+				double dist_squared = dx * dx + dy * dy + FIELD_SOFTENING * FIELD_SOFTENING;
+				double scale = attractors[a].gravity / (dist_squared * sqrt(dist_squared));
+				ax += dx * scale;
+				ay += dy * scale;
+			}
+			gravity_field[2 * (row * FIELD_COLUMNS + column)] = (float)ax;
+			gravity_field[2 * (row * FIELD_COLUMNS + column) + 1] = (float)ay;
+		}
+	}
+}
+#endif
+
+#if INTEGRATOR != EULER_REFERENCE
+// Position and velocity of one satelite in double precision
+typedef struct{
+	double x;
+	double y;
+	double vx;
+	double vy;
+} orbit;
+
+// Time derivative of the orbit: velocity and gravity of the black hole,
+// same force as in the Euler reference
+orbit orbitDerivative(orbit state){
+	double dx = state.x - HORIZONTAL_CENTER;
+	double dy = state.y - VERTICAL_CENTER;
+	double distSquared = dx * dx + dy * dy;
+	double scale = -GRAVITY / (distSquared * sqrt(distSquared));
+	orbit derivative = {.x = state.vx, .y = state.vy,
+							  .vx = dx * scale, .vy = dy * scale};
+	return derivative;
+}
+
+// state + h * derivative
+orbit orbitStep(orbit state, orbit derivative, double h){
+	orbit result = {.x = state.x + h * derivative.x, .y = state.y + h * derivative.y,
+						 .vx = state.vx + h * derivative.vx, .vy = state.vy + h * derivative.vy};
+	return result;
+}
+
+orbit loadOrbit(int i){
+	orbit state = {.x = satelites[i].position.x, .y = satelites[i].position.y,
+						.vx = satelites[i].velocity.x, .vy = satelites[i].velocity.y};
+	return state;
+}
+
+void storeOrbit(int i, orbit state){
+	satelites[i].position.x = state.x;
+	satelites[i].position.y = state.y;
+	satelites[i].velocity.x = state.vx;
+	satelites[i].velocity.y = state.vy;
+}
+#endif
+
+#if INTEGRATOR == LEAPFROG
+// Velocity Verlet (kick-drift-kick), gravity at the end of a step is reused
+// at the start of the next one, so a frame takes INTEGRATOR_STEPS + 1 evaluations
+void integrateSatelite(int i, double deltaTime){
+	double h = deltaTime / INTEGRATOR_STEPS;
+	orbit state = loadOrbit(i);
+	orbit derivative = orbitDerivative(state);
+	for(int step = 0; step < INTEGRATOR_STEPS; ++step){
+		state.vx += 0.5 * h * derivative.vx;
+		state.vy += 0.5 * h * derivative.vy;
+		state.x += h * state.vx;
+		state.y += h * state.vy;
+		derivative = orbitDerivative(state);
+		state.vx += 0.5 * h * derivative.vx;
+		state.vy += 0.5 * h * derivative.vy;
+	}
+	storeOrbit(i, state);
+}
+#endif
+
+#if INTEGRATOR == RK4
+// Classic fourth order Runge-Kutta, four evaluations per step
+void integrateSatelite(int i, double deltaTime){
+	double h = deltaTime / INTEGRATOR_STEPS;
+	orbit state = loadOrbit(i);
+	for(int step = 0; step < INTEGRATOR_STEPS; ++step){
+		orbit k1 = orbitDerivative(state);
+		orbit k2 = orbitDerivative(orbitStep(state, k1, 0.5 * h));
+		orbit k3 = orbitDerivative(orbitStep(state, k2, 0.5 * h));
+		orbit k4 = orbitDerivative(orbitStep(state, k3, h));
+		state.x += h / 6.0 * (k1.x + 2.0 * k2.x + 2.0 * k3.x + k4.x);
+		state.y += h / 6.0 * (k1.y + 2.0 * k2.y + 2.0 * k3.y + k4.y);
+		state.vx += h / 6.0 * (k1.vx + 2.0 * k2.vx + 2.0 * k3.vx + k4.vx);
+		state.vy += h / 6.0 * (k1.vy + 2.0 * k2.vy + 2.0 * k3.vy + k4.vy);
+	}
+	storeOrbit(i, state);
+}
+#endif
+
+#if INTEGRATOR == ADAPTIVE_RK
+// Dormand-Prince 5(4) tableau: stage coefficients, fifth order weights
+// (same as the last stage) and difference to the fourth order weights
+const double dormandPrinceA[7][6] = {
+	{0},
+	{1.0 / 5.0},
+	{3.0 / 40.0, 9.0 / 40.0},
+	{44.0 / 45.0, -56.0 / 15.0, 32.0 / 9.0},
+	{19372.0 / 6561.0, -25360.0 / 2187.0, 64448.0 / 6561.0, -212.0 / 729.0},
+	{9017.0 / 3168.0, -355.0 / 33.0, 46732.0 / 5247.0, 49.0 / 176.0, -5103.0 / 18656.0},
+	{35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0, -2187.0 / 6784.0, 11.0 / 84.0}};
+const double dormandPrinceError[7] = {71.0 / 57600.0, 0.0, -71.0 / 16695.0, 71.0 / 1920.0,
+	-17253.0 / 339200.0, 22.0 / 525.0, -1.0 / 40.0};
+
+// Embedded Runge-Kutta with step size control. Error of a step is the
+// position error plus velocity error over the step, in pixels. Last stage is
+// the derivative at the accepted state and starts the next step
+void integrateSatelite(int i, double deltaTime){
+	orbit state = loadOrbit(i);
+	orbit k[7];
+	k[0] = orbitDerivative(state);
+	double h = integrator_step[i] > 0.0 ? integrator_step[i] : deltaTime;
+	double time = 0.0;
+	while(time < deltaTime){
+		int lastStep = time + h >= deltaTime;
+		double stepSize = lastStep ? deltaTime - time : h;
+		orbit next = state;
+		for(int s = 1; s < 7; ++s){
+			orbit stage = state;
+			for(int j = 0; j < s; ++j){
+				stage = orbitStep(stage, k[j], stepSize * dormandPrinceA[s][j]);
+			}
+			k[s] = orbitDerivative(stage);
+			next = stage;
+		}
+		orbit error = {0};
+		for(int s = 0; s < 7; ++s){
+			error = orbitStep(error, k[s], stepSize * dormandPrinceError[s]);
+		}
+		double positionError = sqrt(error.x * error.x + error.y * error.y);
+		double velocityError = sqrt(error.vx * error.vx + error.vy * error.vy) * stepSize;
+		double ratio = fmax(positionError, velocityError) / INTEGRATOR_TOLERANCE;
+
+		// Grow at most 5x and shrink at most 5x per step
+		double scale = ratio > 0.0 ? 0.9 * pow(ratio, -0.2) : 5.0;
+		scale = fmin(5.0, fmax(0.2, scale));
+		if(ratio <= 1.0 || stepSize < deltaTime * 1e-9){
+			time = lastStep ? deltaTime : time + stepSize;
+			state = next;
+			k[0] = k[6];
+			// Shortened last step does not limit the next frame
+			if(!lastStep || scale < 1.0){
+				h = stepSize * scale;
+			}
+		}
+		else{
+			h = stepSize * scale;
+		}
+	}
+	integrator_step[i] = h;
+	storeOrbit(i, state);
+}
+#endif
+
+
+#if SIMD_PHYSICS
+// Euler reference for a vector of satelites. Lanes do the same operations
+// in the same order as the scalar loop, division included, so they give the
+// same floats. Velocity change of a substep does not change during a frame
+// and is computed once, like the compiler does for the scalar loop.
+__attribute__((target("avx512f")))
+void integrateLanesAvx512(int first, float deltaTime, float updates){
+	__m512 x = _mm512_load_ps(physics_position_x + first);
+	__m512 y = _mm512_load_ps(physics_position_y + first);
+	__m512 vx = _mm512_load_ps(physics_velocity_x + first);
+	__m512 vy = _mm512_load_ps(physics_velocity_y + first);
+	__m512 timeStep = _mm512_set1_ps(deltaTime);
+	__m512 updateCount = _mm512_set1_ps(updates);
+	__m512 dx = _mm512_sub_ps(x, _mm512_set1_ps(HORIZONTAL_CENTER));
+	__m512 dy = _mm512_sub_ps(y, _mm512_set1_ps(VERTICAL_CENTER));
+	__m512 distSquared = _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy));
+	__m512 dist = _mm512_sqrt_ps(distSquared);
+	__m512 accumulation = _mm512_div_ps(_mm512_set1_ps(GRAVITY), distSquared);
+	__m512 kickX = _mm512_div_ps(_mm512_mul_ps(_mm512_mul_ps(accumulation, _mm512_div_ps(dx, dist)), timeStep), updateCount);
+	__m512 kickY = _mm512_div_ps(_mm512_mul_ps(_mm512_mul_ps(accumulation, _mm512_div_ps(dy, dist)), timeStep), updateCount);
+	for(int update = 0; update < (int)updates; ++update){
+		vx = _mm512_sub_ps(vx, kickX);
+		vy = _mm512_sub_ps(vy, kickY);
+		x = _mm512_add_ps(x, _mm512_div_ps(_mm512_mul_ps(vx, timeStep), updateCount));
+		y = _mm512_add_ps(y, _mm512_div_ps(_mm512_mul_ps(vy, timeStep), updateCount));
+	}
+	_mm512_store_ps(physics_position_x + first, x);
+	_mm512_store_ps(physics_position_y + first, y);
+	_mm512_store_ps(physics_velocity_x + first, vx);
+	_mm512_store_ps(physics_velocity_y + first, vy);
+}
+
+__attribute__((target("avx")))
+void integrateLanesAvx(int first, float deltaTime, float updates){
+	__m256 x = _mm256_load_ps(physics_position_x + first);
+	__m256 y = _mm256_load_ps(physics_position_y + first);
+	__m256 vx = _mm256_load_ps(physics_velocity_x + first);
+	__m256 vy = _mm256_load_ps(physics_velocity_y + first);
+	__m256 timeStep = _mm256_set1_ps(deltaTime);
+	__m256 updateCount = _mm256_set1_ps(updates);
+	__m256 dx = _mm256_sub_ps(x, _mm256_set1_ps(HORIZONTAL_CENTER));
+	__m256 dy = _mm256_sub_ps(y, _mm256_set1_ps(VERTICAL_CENTER));
+	__m256 distSquared = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+	__m256 dist = _mm256_sqrt_ps(distSquared);
+	__m256 accumulation = _mm256_div_ps(_mm256_set1_ps(GRAVITY), distSquared);
+	__m256 kickX = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(accumulation, _mm256_div_ps(dx, dist)), timeStep), updateCount);
+	__m256 kickY = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(accumulation, _mm256_div_ps(dy, dist)), timeStep), updateCount);
+	for(int update = 0; update < (int)updates; ++update){
+		vx = _mm256_sub_ps(vx, kickX);
+		vy = _mm256_sub_ps(vy, kickY);
+		x = _mm256_add_ps(x, _mm256_div_ps(_mm256_mul_ps(vx, timeStep), updateCount));
+		y = _mm256_add_ps(y, _mm256_div_ps(_mm256_mul_ps(vy, timeStep), updateCount));
+	}
+	_mm256_store_ps(physics_position_x + first, x);
+	_mm256_store_ps(physics_position_y + first, y);
+	_mm256_store_ps(physics_velocity_x + first, vx);
+	_mm256_store_ps(physics_velocity_y + first, vy);
+}
+
+void integrateLanesSse2(int first, float deltaTime, float updates){
+	__m128 x = _mm_load_ps(physics_position_x + first);
+	__m128 y = _mm_load_ps(physics_position_y + first);
+	__m128 vx = _mm_load_ps(physics_velocity_x + first);
+	__m128 vy = _mm_load_ps(physics_velocity_y + first);
+	__m128 timeStep = _mm_set1_ps(deltaTime);
+	__m128 updateCount = _mm_set1_ps(updates);
+	__m128 dx = _mm_sub_ps(x, _mm_set1_ps(HORIZONTAL_CENTER));
+	__m128 dy = _mm_sub_ps(y, _mm_set1_ps(VERTICAL_CENTER));
+	__m128 distSquared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+	__m128 dist = _mm_sqrt_ps(distSquared);
+	__m128 accumulation = _mm_div_ps(_mm_set1_ps(GRAVITY), distSquared);
+	__m128 kickX = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(accumulation, _mm_div_ps(dx, dist)), timeStep), updateCount);
+	__m128 kickY = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(accumulation, _mm_div_ps(dy, dist)), timeStep), updateCount);
+	for(int update = 0; update < (int)updates; ++update){
+		vx = _mm_sub_ps(vx, kickX);
+		vy = _mm_sub_ps(vy, kickY);
+		x = _mm_add_ps(x, _mm_div_ps(_mm_mul_ps(vx, timeStep), updateCount));
+		y = _mm_add_ps(y, _mm_div_ps(_mm_mul_ps(vy, timeStep), updateCount));
+	}
+	_mm_store_ps(physics_position_x + first, x);
+	_mm_store_ps(physics_position_y + first, y);
+	_mm_store_ps(physics_velocity_x + first, vx);
+	_mm_store_ps(physics_velocity_y + first, vy);
+}
+
+// Picks the widest instruction set supported by the CPU
+void selectSimdIntegrate(){
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f")){
+		printf("SIMD physics engine: AVX-512\n");
+		simd_integrate = integrateLanesAvx512;
+		simd_physics_lanes = 16;
+	}
+	else if(__builtin_cpu_supports("avx")){
+		printf("SIMD physics engine: AVX\n");
+		simd_integrate = integrateLanesAvx;
+		simd_physics_lanes = 8;
+	}
+	else{
+		printf("SIMD physics engine: SSE2\n");
+		simd_integrate = integrateLanesSse2;
+		simd_physics_lanes = 4;
+	}
+}
+
+// Satelites are copied to the arrays, integrated a vector at a time in
+// registers and written back once a frame
+void simdPhysicsEngine(int deltaTime, int updates){
+	for(int i = 0; i < PHYSICS_LANE_CAPACITY; ++i){
+		// Padding lanes repeat the last satelite and are not written back
+		int j = i < SATELITE_COUNT ? i : SATELITE_COUNT - 1;
+		physics_position_x[i] = satelites[j].position.x;
+		physics_position_y[i] = satelites[j].position.y;
+		physics_velocity_x[i] = satelites[j].velocity.x;
+		physics_velocity_y[i] = satelites[j].velocity.y;
+	}
+
+	#pragma omp parallel for schedule(static)
+	for(int first = 0; first < SATELITE_COUNT; first += simd_physics_lanes){
+		simd_integrate(first, deltaTime, updates);
+	}
+
+	for(int i = 0; i < SATELITE_COUNT; ++i){
+		// Report movement of the frame, renderer uses it to bound which pixels can change
+		double movedX = (double)physics_position_x[i] - satelites[i].position.x;
+		double movedY = (double)physics_position_y[i] - satelites[i].position.y;
+		satelite_displacement[i] = sqrt(movedX * movedX + movedY * movedY);
+		satelites[i].position.x = physics_position_x[i];
+		satelites[i].position.y = physics_position_y[i];
+		satelites[i].velocity.x = physics_velocity_x[i];
+		satelites[i].velocity.y = physics_velocity_y[i];
+	}
+}
+#endif
+
 // ## You are asked to make this code parallel ##
 // Physics engine loop. (This is called once a frame before graphics engine) 
 // Moves the satelites based on gravity
 // This is done multiple times in a frame because the Euler integration 
 // is not accurate enough to be done only once
 void parallelPhysicsEngine(int deltaTime){
+	// Fixed step makes runs with the same seed identical
+	if(fixedDeltaTime > 0){
+		deltaTime = fixedDeltaTime;
+	}
+#if DEVICE_PHYSICS
+	//Every device moves its own satelites, in-order queue renders after this
+	for (int i = 0; i< num_of_cldevices;i++){
+		cl_int ret = clSetKernelArg(cl_devices[i].integrate_kernel, 1, sizeof(int), (void *)&deltaTime);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg integrate 1\n", __LINE__);
+		size_t satelite_items = SATELITE_COUNT;
+		ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].integrate_kernel, 1, NULL, &satelite_items, NULL, 0, NULL, NULL);
+		checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel integrate\n", __LINE__);
+	}
+#else
+#if INTEGRATOR == EULER_REFERENCE
    const int physicsUpdatesInOneFrame = 10000;
+#endif
+#if SIMD_PHYSICS
+	simdPhysicsEngine(deltaTime, physicsUpdatesInOneFrame);
+#else
 	#pragma omp parallel for num_threads(SATELITE_COUNT)
    for(int i = 0; i < SATELITE_COUNT; ++i){
+      vector startPosition = satelites[i].position;
+#if INTEGRATOR != EULER_REFERENCE
+      integrateSatelite(i, deltaTime);
+#else
       // Distance to the blackhole (bit ugly code because C-struct cannot have member functions)
       vector positionToBlackHole = {.x = satelites[i].position.x -
          HORIZONTAL_CENTER, .y = satelites[i].position.y - VERTICAL_CENTER};
@@ -529,7 +2238,15 @@ void parallelPhysicsEngine(int deltaTime){
 	      satelites[i].position.x = satelites[i].position.x + satelites[i].velocity.x * deltaTime / physicsUpdatesInOneFrame;
 	      satelites[i].position.y = satelites[i].position.y + satelites[i].velocity.y * deltaTime / physicsUpdatesInOneFrame;
       }
+#endif
+
+      // Report movement of the frame, renderer uses it to bound which pixels can change
+      double movedX = (double)satelites[i].position.x - startPosition.x;
+      double movedY = (double)satelites[i].position.y - startPosition.y;
+      satelite_displacement[i] = sqrt(movedX * movedX + movedY * movedY);
    }
+#endif
+#endif
 }
 
 // ## You are asked to make this code parallel ##
@@ -538,6 +2255,19 @@ void parallelPhysicsEngine(int deltaTime){
 void parallelGraphicsEngine(){
 
 	cl_int ret = 0;
+#if FRAME_DUMP == DUMP_IDS
+	beginDumpFrame();
+#endif
+#if RENDER_MODE == TILE_BINNING
+	binSatelitesToTiles();
+	for (int i = 0; i< num_of_cldevices;i++){
+		uploadTileCandidates(i);
+	}
+#endif
+#if RENDER_MODE == TEMPORAL_COHERENCE || RENDER_MODE == DIRTY_REGION
+	float displacement = frameDisplacement();
+#endif
+#if !DEVICE_PHYSICS
 	//Copy Satellite positions to all Available devices
 	for (int i = 0; i< num_of_cldevices;i++){
 		ret = clEnqueueWriteBuffer(cl_devices[i].command_queue, cl_devices[i].satelite_data_gpu, CL_TRUE, 0, SATELITE_COUNT * sizeof(satelite), satelites, 0, NULL, &cl_devices[i].evnt);
@@ -550,15 +2280,59 @@ void parallelGraphicsEngine(){
 		checkAndHandleErr(ret, i, "ERROR clEnqueueWriteBuffer\n", __LINE__);
 		clReleaseEvent(cl_devices[i].evnt);
 	}
+#endif
 	
 	//Do calculation
 	for (int i = 0;i<num_of_cldevices; i++){
-		ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].kernel, 1, NULL, &cl_devices[i].global_size, &cl_devices[i].local_size, 0, NULL, &cl_devices[i].evnt);
+	#if RENDER_MODE == JUMP_FLOOD
+		enqueueJumpFlood(i);
+	#elif RENDER_MODE == BLOCK_FILL
+		ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].block_kernel, 1, NULL, &cl_devices[i].block_global_size, NULL, 0, NULL, &cl_devices[i].evnt);
+		checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel render_blocks\n", __LINE__);
+	#elif RENDER_MODE == TILE_BINNING
+		size_t share_size = cl_devices[i].pixel_arr_size;
+		ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].tile_kernel, 1, NULL, &share_size, &cl_devices[i].local_size, 0, NULL, &cl_devices[i].evnt);
+		checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel render_tiles\n", __LINE__);
+	#elif RENDER_MODE == TEMPORAL_COHERENCE
+		size_t share_size = cl_devices[i].pixel_arr_size;
+		ret = clSetKernelArg(cl_devices[i].coherent_kernel, 5, sizeof(float), (void *)&displacement);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_coherent 5\n", __LINE__);
+		ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].coherent_kernel, 1, NULL, &share_size, &cl_devices[i].local_size, 0, NULL, &cl_devices[i].evnt);
+		checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel render_coherent\n", __LINE__);
+	#elif RENDER_MODE == DIRTY_REGION
+		size_t share_size = cl_devices[i].pixel_arr_size;
+		int zero = 0;
+		ret = clEnqueueWriteBuffer(cl_devices[i].command_queue, cl_devices[i].dirty_count_gpu, CL_TRUE, 0, sizeof(int), &zero, 0, NULL, NULL);
+		checkAndHandleErr(ret, i, "ERROR clEnqueueWriteBuffer dirty_count_gpu\n", __LINE__);
+		ret = clSetKernelArg(cl_devices[i].dirty_kernel, 7, sizeof(float), (void *)&displacement);
+		checkAndHandleErr(ret, i, "ERROR clSetKernelArg render_dirty 7\n", __LINE__);
+		ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].dirty_kernel, 1, NULL, &share_size, &cl_devices[i].local_size, 0, NULL, &cl_devices[i].evnt);
+		checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel render_dirty\n", __LINE__);
+	#else
+		ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].kernel, 1, NULL, &cl_devices[i].global_size, &cl_devices[i].local_size, 0, NULL, NULL);
 		if (ret != CL_SUCCESS){
 			checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel\n", __LINE__);	
 		}
+		//In-order queue, disks are stamped over the finished owner pass
+		size_t disk_items = SATELITE_COUNT * DISK_SPAN * DISK_SPAN;
+		ret = clEnqueueNDRangeKernel(cl_devices[i].command_queue, cl_devices[i].disk_kernel, 1, NULL, &disk_items, NULL, 0, NULL, &cl_devices[i].evnt);
+		checkAndHandleErr(ret, i, "ERROR clEnqueueNDRangeKernel stamp_disks\n", __LINE__);
+	#endif
 	}
 	
+#if RENDER_MODE == DIRTY_REGION
+	for (int i = 0;i<num_of_cldevices; i++){
+		readDirtyPixels(i);
+	}
+#elif RLE_READBACK
+	for (int i = 0;i<num_of_cldevices; i++){
+		readRunLengthPixels(i);
+	}
+#elif DELTA_READBACK
+	for (int i = 0;i<num_of_cldevices; i++){
+		readDeltaPixels(i);
+	}
+#else
 	//Wait calculation to finished and transfer results
 	for (int i = 0;i<num_of_cldevices; i++){
 		ret = clWaitForEvents(1, &cl_devices[i].evnt);
@@ -581,7 +2355,8 @@ void parallelGraphicsEngine(){
 											
 		checkAndHandleErr(ret, i, "ERROR clEnqueueWriteBuffer\n", __LINE__);
 	}
-	color default_cl = {.red = 1.0f, .green= 1.0f, .blue=1.0f};
+	//Colors are needed on host only for the error checked frames
+	int color_pixels = !PALETTE_DISPLAY || frameNumber < 2;
 	
 	//Wait data transfer to complete before continue
 	//#pragma omp parallel for num_threads(num_of_cldevices)
@@ -590,6 +2365,9 @@ void parallelGraphicsEngine(){
 		ret = clWaitForEvents(1, &cl_devices[d].evnt);
 		checkAndHandleErr(ret, d, "ERROR clEnqueueWriteBuffer\n", __LINE__);
 		clReleaseEvent(cl_devices[d].evnt);
+		if (!color_pixels){
+			continue;
+		}
 		
 		//Loop through all satelite ID:s and assign final colors to pixel -array
 		int offset_start = (cl_devices[d].global_start_y);
@@ -603,18 +2381,24 @@ void parallelGraphicsEngine(){
 			int id = cl_devices[d].pixel_ids[i-offset_start];
 				if (id == 0xFFFF){
 			#endif
-				pixels[i] = default_cl;
+				pixels[i] = white_color;
 			}
 			else{
-				#if SATELITE_COUNT < 255
-				color cl = satelites[(uint8_t)id].identifier;
-				#else
-				color cl = satelites[(int)id].identifier;
-				#endif
-				pixels[i] = cl;
+				pixels[i] = satelite_colors[id];
 			}
 		}
 	}
+#endif
+#if FRAME_DUMP
+	endDumpFrame();
+#endif
+#if DEVICE_PHYSICS
+	//Positions are needed on host only for the error checked frames, all devices hold the same
+	if (frameNumber < 2){
+		ret = clEnqueueReadBuffer(cl_devices[0].command_queue, cl_devices[0].satelite_data_gpu, CL_TRUE, 0, SATELITE_COUNT * sizeof(satelite), satelites, 0, NULL, NULL);
+		checkAndHandleErr(ret, 0, "ERROR clEnqueueReadBuffer satelite_data_gpu\n", __LINE__);
+	}
+#endif
 
 }
 
@@ -627,6 +2411,72 @@ void destroy(){
 		checkAndHandleErr(ret, i, "ERROR clFinish\n", __LINE__);
 		ret = clReleaseKernel(cl_devices[i].kernel);
 		checkAndHandleErr(ret, i, "ERROR clReleaseKernel\n", __LINE__);
+	#if RENDER_MODE == BRUTE_FORCE || RENDER_MODE == JUMP_FLOOD
+		clReleaseKernel(cl_devices[i].disk_kernel);
+	#endif
+	#if DEVICE_PHYSICS
+		clReleaseKernel(cl_devices[i].integrate_kernel);
+	#endif
+	#if GRAVITY_FIELD
+		clReleaseMemObject(cl_devices[i].field_image);
+	#endif
+	#if RENDER_MODE == JUMP_FLOOD
+		clReleaseKernel(cl_devices[i].jfa_clear_kernel);
+		clReleaseKernel(cl_devices[i].jfa_seed_kernel);
+		clReleaseKernel(cl_devices[i].jfa_reseed_kernel);
+		clReleaseKernel(cl_devices[i].jfa_step_kernel);
+		clReleaseKernel(cl_devices[i].jfa_refine_kernel);
+		clReleaseKernel(cl_devices[i].jfa_resolve_kernel);
+		clReleaseMemObject(cl_devices[i].owner_gpu[0]);
+		clReleaseMemObject(cl_devices[i].owner_gpu[1]);
+	#endif
+	#if RENDER_MODE == BLOCK_FILL
+		clReleaseKernel(cl_devices[i].block_kernel);
+	#endif
+	#if RENDER_MODE == TILE_BINNING
+		clReleaseKernel(cl_devices[i].tile_kernel);
+		clReleaseMemObject(cl_devices[i].tile_start_gpu);
+		clReleaseMemObject(cl_devices[i].tile_candidates_gpu);
+	#endif
+	#if RENDER_MODE == TEMPORAL_COHERENCE
+		clReleaseKernel(cl_devices[i].coherent_kernel);
+		clReleaseMemObject(cl_devices[i].last_owner_gpu);
+		clReleaseMemObject(cl_devices[i].last_margin_gpu);
+	#endif
+	#if RENDER_MODE == DIRTY_REGION
+		clReleaseKernel(cl_devices[i].dirty_kernel);
+		clReleaseMemObject(cl_devices[i].last_owner_gpu);
+		clReleaseMemObject(cl_devices[i].last_margin_gpu);
+		clReleaseMemObject(cl_devices[i].last_disk_gpu);
+	#endif
+	#if RENDER_MODE == DIRTY_REGION || DELTA_READBACK
+		clReleaseMemObject(cl_devices[i].dirty_gpu);
+		clReleaseMemObject(cl_devices[i].dirty_count_gpu);
+		free(cl_devices[i].dirty);
+	#endif
+	#if DELTA_READBACK
+		clReleaseKernel(cl_devices[i].delta_flags_kernel);
+		clReleaseKernel(cl_devices[i].delta_scatter_kernel);
+		clReleaseKernel(cl_devices[i].scan_blocks_kernel);
+		clReleaseKernel(cl_devices[i].scan_add_kernel);
+		clReleaseMemObject(cl_devices[i].previous_ids_gpu);
+		clReleaseMemObject(cl_devices[i].delta_flags_gpu);
+		clReleaseMemObject(cl_devices[i].delta_offsets_gpu);
+		for (int level = 0; level < SCAN_LEVELS; level++){
+			clReleaseMemObject(cl_devices[i].scan_sums_gpu[level]);
+			clReleaseMemObject(cl_devices[i].scan_offsets_gpu[level]);
+		}
+	#endif
+	#if RLE_READBACK
+		clReleaseKernel(cl_devices[i].rle_count_kernel);
+		clReleaseKernel(cl_devices[i].rle_offsets_kernel);
+		clReleaseKernel(cl_devices[i].rle_write_kernel);
+		clReleaseMemObject(cl_devices[i].row_runs_gpu);
+		clReleaseMemObject(cl_devices[i].row_offsets_gpu);
+		clReleaseMemObject(cl_devices[i].runs_gpu);
+		free(cl_devices[i].row_offsets);
+		free(cl_devices[i].runs);
+	#endif
 		ret = clReleaseProgram(cl_devices[i].program);
 		checkAndHandleErr(ret, i, "ERROR clReleaseProgram\n", __LINE__);
 		ret = clReleaseMemObject(cl_devices[i].satelite_data_gpu);
@@ -639,11 +2489,115 @@ void destroy(){
 		checkAndHandleErr(ret, i, "ERROR clReleaseCommandQueue\n", __LINE__);
 		ret = clReleaseContext(cl_devices[i].context);
 		checkAndHandleErr(ret, i, "ERROR clReleaseContext\n", __LINE__);
+	#if !PALETTE_DISPLAY && FRAME_DUMP != DUMP_IDS
    	free(cl_devices[i].pixel_ids);
+	#endif
 	}
 	free(cl_devices);
+#if PALETTE_DISPLAY
+	free(owner_ids);
+	glDeleteTextures(1, &owner_texture);
+	glDeleteTextures(1, &palette_texture);
+	glDeleteProgram(palette_program);
+#endif
+#if RENDER_MODE == TILE_BINNING
+	free(tile_start);
+	free(tile_bound);
+	free(tile_candidates);
+#endif
+	free(satelite_displacement);
+#if INTEGRATOR == ADAPTIVE_RK
+	free(integrator_step);
+#endif
+#if GRAVITY_FIELD
+	free(attractors);
+	free(gravity_field);
+#endif
+#if SIMD_PHYSICS
+	_mm_free(physics_position_x);
+	_mm_free(physics_position_y);
+	_mm_free(physics_velocity_x);
+	_mm_free(physics_velocity_y);
+#endif
+	free(satelite_colors);
+#if FRAME_DUMP
+	stopFrameDump();
+#endif
+#if PBO_DISPLAY
+	destroyPixelBuffers();
+#endif
+}
+
+// Reads options given after the seed: --dt <ms> and frame count of headless mode
+void parseOptions(int argc, char** argv, int* frames){
+	for(int i = 2; i < argc; ++i){
+		if(strcmp(argv[i], "--dt") == 0 && i + 1 < argc){
+			fixedDeltaTime = atoi(argv[++i]);
+			printf("Using fixed time step: %ims\n", fixedDeltaTime);
+		}
+		else{
+			*frames = atoi(argv[i]);
+		}
+	}
 }
 
+#if HEADLESS
+void sequentialGraphicsEngine();
+void errorCheck();
+
+//Milliseconds from monotonic clock, replaces glutGet(GLUT_ELAPSED_TIME)
+double monotonicTime(){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+// FNV-1a hash of the pixel buffer, equal for equal frames of any engine
+unsigned long long pixelHash(){
+	const unsigned char* bytes = (const unsigned char*)pixels;
+	unsigned long long hash = 14695981039346656037ULL;
+	for(size_t i = 0; i < sizeof(pixels[0]) * SIZE; ++i){
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+//Same frame loop as compute, but without window
+void runHeadless(int frames){
+	double physics_total = 0.0;
+	double graphics_total = 0.0;
+	double previous_frame_time = monotonicTime();
+	double run_start = previous_frame_time;
+	for (int frame = 0; frame < frames; frame++){
+		double frame_start = monotonicTime();
+		int deltaTime = (int)(frame_start - previous_frame_time);
+		previous_frame_time = frame_start;
+		
+		parallelPhysicsEngine(deltaTime);
+		double physics_end = monotonicTime();
+		
+		parallelGraphicsEngine();
+		double graphics_end = monotonicTime();
+		
+		if (frameNumber < 2){
+			sequentialGraphicsEngine();
+			errorCheck();
+		}
+		physics_total += physics_end - frame_start;
+		graphics_total += graphics_end - physics_end;
+		printf("Total frametime: %ims, satelite moving: %.2fms, space coloring: %.2fms.\n",
+			deltaTime, physics_end - frame_start, graphics_end - physics_end);
+		frameNumber++;
+	}
+	double run_time = monotonicTime() - run_start;
+	printf("Headless run of %i frames: %.2fms, average satelite moving: %.2fms, space coloring: %.2fms.\n",
+		frames, run_time, physics_total / frames, graphics_total / frames);
+	if (fixedDeltaTime > 0){
+		printf("Last frame hash: %016llx\n", pixelHash());
+	}
+}
+#endif
+
 
 
 ////////////////////////////////////////////////
@@ -680,7 +2634,7 @@ void sequentialGraphicsEngine(){
          }
       }
 
-      correctPixels[i] = renderColor;
+      correctPixels[i] = toPixelColor(renderColor);
    }
 }
 
@@ -690,9 +2644,9 @@ void errorCheck(){
       if(correctPixels[i].red != pixels[i].red ||
          correctPixels[i].green != pixels[i].green ||
          correctPixels[i].blue != pixels[i].blue){ 
-			printf("cp_r:%.6f cp_g:%.6f cp_b:%.6f   px_r:%.6f px_g:%.6f px_b:%.6f\n", 	correctPixels[i].red,correctPixels[i].green,
-																							 					correctPixels[i].blue,pixels[i].red,
-																							 					pixels[i].green,pixels[i].blue);
+			printf("cp_r:%.6f cp_g:%.6f cp_b:%.6f   px_r:%.6f px_g:%.6f px_b:%.6f\n", 	(double)correctPixels[i].red,(double)correctPixels[i].green,
+																							 					(double)correctPixels[i].blue,(double)pixels[i].red,
+																							 					(double)pixels[i].green,(double)pixels[i].blue);
          printf("Buggy pixel at (x=%i, y=%i). Press enter to continue.\n", i % WINDOW_WIDTH, i / WINDOW_WIDTH);
          getchar();
          return;
@@ -701,6 +2655,7 @@ void errorCheck(){
    printf("Error check passed!\n");
 }
 
+#if !HEADLESS
 // ¤¤ DO NOT EDIT THIS FUNCTION ¤¤
 void compute(void){
    int timeSinceStart = glutGet(GLUT_ELAPSED_TIME);
@@ -729,6 +2684,7 @@ void compute(void){
    // Render the frame
    glutPostRedisplay();
 }
+#endif
 
 // ¤¤ DO NOT EDIT THIS FUNCTION ¤¤
 // Probably not the best random number generator
@@ -744,10 +2700,10 @@ void fixedInit(unsigned int seed){
    }
 
    // Init pixel buffer which is rendered to the widow
-   pixels = (color*)malloc(sizeof(color) * SIZE);
+   pixels = (pixel_color*)malloc(sizeof(pixel_color) * SIZE);
 
    // Init pixel buffer which is used for error checking
-   correctPixels = (color*)malloc(sizeof(color) * SIZE);
+   correctPixels = (pixel_color*)malloc(sizeof(pixel_color) * SIZE);
 
    // Init satelites buffer which are moving in the space
    satelites = (satelite*)malloc(sizeof(satelite) * SATELITE_COUNT);
@@ -802,14 +2758,22 @@ void fixedDestroy(void){
    }
 }
 
+#if !HEADLESS
 // ¤¤ DO NOT EDIT THIS FUNCTION ¤¤
 // Renders pixels-buffer to the window 
 void render(void){
    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-   glDrawPixels(WINDOW_WIDTH, WINDOW_HEIGHT, GL_RGB, GL_FLOAT, pixels);
+#if PALETTE_DISPLAY
+   drawPaletteDisplay();
+#elif PBO_DISPLAY
+   drawPixelBuffer();
+#else
+   glDrawPixels(WINDOW_WIDTH, WINDOW_HEIGHT, PIXEL_GL_FORMAT, PIXEL_GL_TYPE, pixels);
+#endif
    glutSwapBuffers();
    frameNumber++;
 }
+#endif
 
 // DO NOT EDIT THIS FUNCTION
 // Inits glut and start mainloop
@@ -819,7 +2783,16 @@ int main(int argc, char** argv){
      seed = atoi(argv[1]);
      printf("Using seed: %i\n", seed);
    }
+   int frames = HEADLESS_FRAMES;
+   parseOptions(argc, argv, &frames);
 
+#if HEADLESS
+   atexit(fixedDestroy);
+   fixedInit(seed);
+   init();
+   runHeadless(frames);
+   return 0;
+#else
    // Init glut window
    glutInit(&argc, argv);
    glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH);
@@ -838,4 +2811,5 @@ int main(int argc, char** argv){
 
    // Start main loop
    glutMainLoop();
+#endif
 }
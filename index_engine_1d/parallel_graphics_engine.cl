@@ -16,11 +16,19 @@ typedef struct{
    vector velocity;
 } satelite;
 
+//Satelite id type of the readback buffer, white marks satelite disks
 #if SAT_COUNT < 255
-	__kernel void render(__constant satelite *satelites,	__global unsigned char *sat_ids,	 __constant int *offset_start) {
+	typedef unsigned char sat_id;
+	#define SAT_WHITE 0xFF
 #else
-	__kernel void render(__constant satelite *satelites,	__global int *sat_ids,	 __constant int *offset_start) {
+	typedef int sat_id;
+	#define SAT_WHITE 0xFFFF
 #endif
+
+// Brute force render mode, owner pass:
+// every pixel is a branch-free min-reduction over all satelites, the white
+// disks are stamped afterwards by stamp_disks
+__kernel void render(__constant satelite *satelites,	__global sat_id *sat_ids,	 __constant int *offset_start) {
  //http://stackoverflow.com/questions/23535040/opencl-size-of-local-memory-has-impact-on-speed
  //https://software.intel.com/en-us/articles/using-opencl-20-work-group-functions
  
@@ -34,29 +42,610 @@ typedef struct{
 		int x = (position) % WINDOW_WIDTH;
 		int y = (position) / WINDOW_HEIGHT;
 		float shortestDistance = INFINITY;
+		int owner = 0;
 
-	#if SAT_COUNT < 255
-		for(unsigned char j = 0; j < SAT_COUNT; ++j){
-	#else
 		for(int j = 0; j < SAT_COUNT; ++j){
-	#endif
 			vector difference = {.x = x - satelites[j].position.x, .y = y - satelites[j].position.y};
 	
 			float dist = sqrt(difference.x * difference.x + difference.y * difference.y);
-			if(dist < shortestDistance){
+			//Strict comparison keeps the first satelite on ties
+			owner = dist < shortestDistance ? j : owner;
+			shortestDistance = dist < shortestDistance ? dist : shortestDistance;
+		}
+		sat_ids[position-offset_start[0]] = owner;
+	}
+
+}
+
+// Brute force render mode, disk pass:
+// a pixel is white if any satelite is closer than SAT_RADIUS, so each work
+// item tests one pixel of one satelite's bounding box and the order of the
+// writes does not matter. Pixels with |x - satelite.x| < SAT_RADIUS are
+// within DISK_SPAN pixels from floor(satelite.x - SAT_RADIUS).
+#define DISK_SPAN ((int)(2 * SAT_RADIUS) + 2)
+
+__kernel void stamp_disks(__constant satelite *satelites, __global sat_id *sat_ids, __constant int *offset_start, int share_size) {
+	int item = get_global_id(0);
+	int j = item / (DISK_SPAN * DISK_SPAN);
+	float left = floor(satelites[j].position.x - SAT_RADIUS);
+	float top = floor(satelites[j].position.y - SAT_RADIUS);
+	//Checked as floats so that satelites far outside do not overflow the int conversion
+	if(!(left > -DISK_SPAN && left < WINDOW_WIDTH && top > -DISK_SPAN && top < WINDOW_HEIGHT)){
+		return;
+	}
+	int x = (int)left + item % DISK_SPAN;
+	int y = (int)top + item / DISK_SPAN % DISK_SPAN;
+	if(x < 0 || x >= WINDOW_WIDTH || y < 0 || y >= WINDOW_HEIGHT){
+		return;
+	}
+	int index = y * WINDOW_WIDTH + x - offset_start[0];
+	if(index < 0 || index >= share_size){
+		return;
+	}
+	vector difference = {.x = x - satelites[j].position.x, .y = y - satelites[j].position.y};
+	float dist = sqrt(difference.x * difference.x + difference.y * difference.y);
+	if(dist < SAT_RADIUS){
+		sat_ids[index] = SAT_WHITE;
+	}
+}
+
+// Jump flooding render mode:
+// owner buffer is cleared, every satelite is seeded to its own pixel and
+// log2(N) passes propagate the closest seed found so far to all pixels.
+// Pixels on cell boundaries are checked exactly by jfa_refine and white
+// disks are stamped afterwards by stamp_disks
+#define JFA_EMPTY 0x7FFFFFFF
+
+__kernel void jfa_clear(__global int *owner) {
+	owner[get_global_id(0)] = JFA_EMPTY;
+}
+
+__kernel void jfa_seed(__global const satelite *satelites, __global int *owner) {
+	int j = get_global_id(0);
+	
+	//Satelites outside the window are seeded to the closest edge pixel
+	int x = clamp((int)(satelites[j].position.x + 0.5f), 0, WINDOW_WIDTH - 1);
+	int y = clamp((int)(satelites[j].position.y + 0.5f), 0, WINDOW_HEIGHT - 1);
+	
+	//Lowest index wins if two satelites land on same pixel, jfa_reseed moves the others
+	atomic_min(&owner[y * WINDOW_WIDTH + x], j);
+}
+
+//Satelites which lost their pixel in jfa_seed take the closest free pixel instead,
+//otherwise they would never be flooded and their whole cell would get the winner
+__kernel void jfa_reseed(__global const satelite *satelites, __global int *owner) {
+	int j = get_global_id(0);
+	int x = clamp((int)(satelites[j].position.x + 0.5f), 0, WINDOW_WIDTH - 1);
+	int y = clamp((int)(satelites[j].position.y + 0.5f), 0, WINDOW_HEIGHT - 1);
+	if (owner[y * WINDOW_WIDTH + x] == j){
+		return;
+	}
+	
+	//Square rings around the pixel, there are fewer satelites than pixels so one is free
+	for (int ring = 1; ring < WINDOW_WIDTH + WINDOW_HEIGHT; ring++){
+		for (int dy = -ring; dy <= ring; dy++){
+			int ny = y + dy;
+			if (ny < 0 || ny >= WINDOW_HEIGHT){
+				continue;
+			}
+			int stride = (dy == -ring || dy == ring) ? 1 : 2 * ring;
+			for (int dx = -ring; dx <= ring; dx += stride){
+				int nx = x + dx;
+				if (nx < 0 || nx >= WINDOW_WIDTH){
+					continue;
+				}
+				if (atomic_cmpxchg(&owner[ny * WINDOW_WIDTH + nx], JFA_EMPTY, j) == JFA_EMPTY){
+					return;
+				}
+			}
+		}
+	}
+}
+
+__kernel void jfa_step(__global const satelite *satelites, __global const int *owner_in, __global int *owner_out, int step) {
+	int position = get_global_id(0);
+	int x = position % WINDOW_WIDTH;
+	int y = position / WINDOW_WIDTH;
+	
+	int best = owner_in[position];
+	float shortestDistance = INFINITY;
+	if (best != JFA_EMPTY){
+		vector difference = {.x = x - satelites[best].position.x, .y = y - satelites[best].position.y};
+		shortestDistance = sqrt(difference.x * difference.x + difference.y * difference.y);
+	}
+	
+	for (int dy = -step; dy <= step; dy += step){
+		int ny = y + dy;
+		if (ny < 0 || ny >= WINDOW_HEIGHT){
+			continue;
+		}
+		for (int dx = -step; dx <= step; dx += step){
+			int nx = x + dx;
+			if (nx < 0 || nx >= WINDOW_WIDTH){
+				continue;
+			}
+			int candidate = owner_in[ny * WINDOW_WIDTH + nx];
+			if (candidate == JFA_EMPTY || candidate == best){
+				continue;
+			}
+			vector difference = {.x = x - satelites[candidate].position.x, .y = y - satelites[candidate].position.y};
+			float dist = sqrt(difference.x * difference.x + difference.y * difference.y);
+			
+			//Same tie break as in sequential engine: first index wins
+			if (dist < shortestDistance || (dist == shortestDistance && candidate < best)){
 				shortestDistance = dist;
-				sat_ids[position-offset_start[0]] = j;
+				best = candidate;
 			}
+		}
+	}
+	owner_out[position] = best;
+}
+
+//Flooding can leave wrong owners near cell boundaries, so pixels whose owner differs
+//from a 4-neighbour's are checked against all satelites, other pixels are copied
+__kernel void jfa_refine(__global const satelite *satelites, __global const int *owner_in, __global int *owner_out) {
+	int position = get_global_id(0);
+	int x = position % WINDOW_WIDTH;
+	int y = position / WINDOW_WIDTH;
+	int owner = owner_in[position];
+	if ((x == 0 || owner_in[position - 1] == owner) &&
+		(x == WINDOW_WIDTH - 1 || owner_in[position + 1] == owner) &&
+		(y == 0 || owner_in[position - WINDOW_WIDTH] == owner) &&
+		(y == WINDOW_HEIGHT - 1 || owner_in[position + WINDOW_WIDTH] == owner)){
+		owner_out[position] = owner;
+		return;
+	}
 	
-			// Display satelites themselves with white
-			if(dist < SAT_RADIUS){
-				#if SAT_COUNT < 255
-					sat_ids[position-offset_start[0]] = 0xFF;
-				#else
-					sat_ids[position-offset_start[0]] = 0xFFFF;
-				#endif
+	//Same comparison as in sequential engine, first satelite wins ties
+	float shortestDistance = INFINITY;
+	for (int j = 0; j < SAT_COUNT; ++j){
+		vector difference = {.x = x - satelites[j].position.x, .y = y - satelites[j].position.y};
+		float dist = sqrt(difference.x * difference.x + difference.y * difference.y);
+		if (dist < shortestDistance){
+			shortestDistance = dist;
+			owner = j;
+		}
+	}
+	owner_out[position] = owner;
+}
+
+__kernel void jfa_resolve(__global const int *owner, __global sat_id *sat_ids, __constant int *offset_start) {
+	int position = offset_start[0] + get_global_id(0); //Owner buffer covers whole window, sat_ids only device share
+	sat_ids[position-offset_start[0]] = owner[position];
+}
+
+// Block fill render mode:
+// Voronoi cells are convex, so if all corners of a block have the same owner
+// with a safe distance gap to the second closest satelite, whole block has it
+#define FILL_TILE 16
+#define FILL_SUB 4
+
+sat_id bruteForcePixel(__global const satelite *satelites, int x, int y) {
+	float shortestDistance = INFINITY;
+	sat_id id = 0;
+	for(int j = 0; j < SAT_COUNT; ++j){
+		vector difference = {.x = x - satelites[j].position.x, .y = y - satelites[j].position.y};
+		float dist = sqrt(difference.x * difference.x + difference.y * difference.y);
+		if(dist < shortestDistance){
+			shortestDistance = dist;
+			id = j;
+		}
+		if(dist < SAT_RADIUS){
+			id = SAT_WHITE;
+		}
+	}
+	return id;
+}
+
+//Returns owner of every pixel in the block or -1 if it cannot be proven
+int blockOwner(__global const satelite *satelites, int x0, int y0, int x1, int y1) {
+	int owner = -1;
+	for (int c = 0; c < 4; c++){
+		float cx = (c & 1) ? x1 : x0;
+		float cy = (c & 2) ? y1 : y0;
+		float first = INFINITY;
+		float second = INFINITY;
+		int closest = -1;
+		for(int j = 0; j < SAT_COUNT; ++j){
+			float dx = cx - satelites[j].position.x;
+			float dy = cy - satelites[j].position.y;
+			float distSquared = dx * dx + dy * dy;
+			if (distSquared < first){
+				second = first;
+				first = distSquared;
+				closest = j;
 			}
+			else if (distSquared < second){
+				second = distSquared;
+			}
+		}
+		//Difference of squared distances is linear in position, gap at corners holds inside
+		if (closest < 0 || (owner >= 0 && closest != owner) || second - first <= 2.0f + 1e-4f * second){
+			return -1;
 		}
+		owner = closest;
 	}
+	
+	//Only disk of the owner can reach pixels of its cell
+	float dx = fmax(fmax(x0 - satelites[owner].position.x, 0.0f), satelites[owner].position.x - x1);
+	float dy = fmax(fmax(y0 - satelites[owner].position.y, 0.0f), satelites[owner].position.y - y1);
+	float diskReach = SAT_RADIUS + 0.01f;
+	if (dx * dx + dy * dy < diskReach * diskReach){
+		return -1;
+	}
+	return owner;
+}
 
+void renderSubBlock(__global const satelite *satelites, __global sat_id *sat_ids, int offset, int x0, int y0, int x1, int y1) {
+	int owner = blockOwner(satelites, x0, y0, x1, y1);
+	for (int y = y0; y <= y1; y++){
+		for (int x = x0; x <= x1; x++){
+			sat_ids[y * WINDOW_WIDTH + x - offset] = owner >= 0 ? (sat_id)owner : bruteForcePixel(satelites, x, y);
+		}
+	}
 }
+
+//One work item per FILL_TILE x FILL_TILE tile of the device share, share must start at row boundary
+__kernel void render_blocks(__global const satelite *satelites, __global sat_id *sat_ids, __constant int *offset_start, int share_rows) {
+	int tiles_in_row = (WINDOW_WIDTH + FILL_TILE - 1) / FILL_TILE;
+	int tile = get_global_id(0);
+	int first_row = offset_start[0] / WINDOW_WIDTH;
+	int last_row = first_row + share_rows - 1;
+	
+	int x0 = tile % tiles_in_row * FILL_TILE;
+	int y0 = first_row + tile / tiles_in_row * FILL_TILE;
+	if (y0 > last_row){
+		return;
+	}
+	int x1 = min(x0 + FILL_TILE - 1, WINDOW_WIDTH - 1);
+	int y1 = min(y0 + FILL_TILE - 1, last_row);
+	
+	int owner = blockOwner(satelites, x0, y0, x1, y1);
+	if (owner >= 0){
+		for (int y = y0; y <= y1; y++){
+			for (int x = x0; x <= x1; x++){
+				sat_ids[y * WINDOW_WIDTH + x - offset_start[0]] = owner;
+			}
+		}
+		return;
+	}
+	
+	//Tile straddles a boundary, test smaller blocks before going pixel by pixel
+	for (int sy = y0; sy <= y1; sy += FILL_SUB){
+		for (int sx = x0; sx <= x1; sx += FILL_SUB){
+			renderSubBlock(satelites, sat_ids, offset_start[0], sx, sy, min(sx + FILL_SUB - 1, x1), min(sy + FILL_SUB - 1, y1));
+		}
+	}
+}
+
+// Tile binning render mode:
+// host bins satelites to BIN_TILE x BIN_TILE tiles every frame and every
+// pixel only checks candidates of its own tile, candidates keep index order
+#ifndef BIN_TILE
+	#define BIN_TILE 16
+#endif
+
+__kernel void render_tiles(__global const satelite *satelites, __global const int *tile_start, __global const int *tile_candidates, __global sat_id *sat_ids, __constant int *offset_start) {
+	int position = offset_start[0] + get_global_id(0);
+	int x = position % WINDOW_WIDTH;
+	int y = position / WINDOW_WIDTH;
+	int tile = (y / BIN_TILE) * ((WINDOW_WIDTH + BIN_TILE - 1) / BIN_TILE) + x / BIN_TILE;
+	
+	float shortestDistance = INFINITY;
+	sat_id id = 0;
+	int end = tile_start[tile + 1];
+	for (int c = tile_start[tile]; c < end; c++){
+		int j = tile_candidates[c];
+		vector difference = {.x = x - satelites[j].position.x, .y = y - satelites[j].position.y};
+		float dist = sqrt(difference.x * difference.x + difference.y * difference.y);
+		if(dist < shortestDistance){
+			shortestDistance = dist;
+			id = j;
+		}
+		
+		// Display satelites themselves with white
+		if(dist < SAT_RADIUS){
+			id = SAT_WHITE;
+		}
+	}
+	sat_ids[position - offset_start[0]] = id;
+}
+
+// Temporal coherence render mode:
+// owner of every pixel and the gap from its distance to the second closest
+// satelite are kept on the device between frames. No satelite has moved more
+// than displacement since the previous frame, so the owner can only lose the
+// pixel after the gap has shrunk by 2 * displacement in total. Pixels with
+// enough gap left check only their owner, others do the full search again.
+#define COHERENCE_SLACK 0.01f //Covers float rounding of the distances
+
+__kernel void render_coherent(__global const satelite *satelites, __global int *last_owner, __global float *last_margin, __global sat_id *sat_ids, __constant int *offset_start, float displacement) {
+	int index = get_global_id(0);
+	int position = offset_start[0] + index;
+	int x = position % WINDOW_WIDTH;
+	int y = position / WINDOW_WIDTH;
+	
+	//NaN or first frame (infinite displacement) always does the full search
+	int owner = last_owner[index];
+	float margin = last_margin[index] - 2.0f * displacement;
+	if (margin > COHERENCE_SLACK && owner >= 0 && owner < SAT_COUNT){
+		vector difference = {.x = x - satelites[owner].position.x, .y = y - satelites[owner].position.y};
+		float dist = sqrt(difference.x * difference.x + difference.y * difference.y);
+		last_margin[index] = margin;
+		sat_ids[index] = dist < SAT_RADIUS ? SAT_WHITE : owner;
+		return;
+	}
+	
+	//Full search in index order, ties keep the first index like sequential engine
+	float shortestDistance = INFINITY;
+	float secondDistance = INFINITY;
+	owner = 0;
+	for(int j = 0; j < SAT_COUNT; ++j){
+		vector difference = {.x = x - satelites[j].position.x, .y = y - satelites[j].position.y};
+		float dist = sqrt(difference.x * difference.x + difference.y * difference.y);
+		if(dist < shortestDistance){
+			secondDistance = shortestDistance;
+			shortestDistance = dist;
+			owner = j;
+		}
+		else if(dist < secondDistance){
+			secondDistance = dist;
+		}
+	}
+	last_owner[index] = owner;
+	last_margin[index] = secondDistance - shortestDistance;
+	sat_ids[index] = shortestDistance < SAT_RADIUS ? SAT_WHITE : owner;
+}
+
+// Dirty region render mode:
+// like temporal coherence, but the signed distance from the owner to the disk
+// edge is kept too. A pixel is dirty when either gap has been used up by the
+// movement of the satelites. Only dirty pixels are recomputed, and only those
+// whose color changed are appended to a compact list which host reads back.
+#if SAT_COUNT < 255
+	typedef uint dirty_entry; //Pixel index of the share in high 24 bits, sat_id in low 8 bits
+	#define DIRTY_ENTRY(pixel, sat) (((uint)(pixel) << 8) | (sat))
+#else
+	typedef struct{
+		int index;
+		int id;
+	} dirty_entry;
+	#define DIRTY_ENTRY(pixel, sat) ((dirty_entry){.index = (pixel), .id = (sat)})
+#endif
+
+__kernel void render_dirty(__global const satelite *satelites, __global int *last_owner, __global float *last_margin, __global float *last_disk, __global dirty_entry *dirty, __global int *dirty_count, __constant int *offset_start, float displacement) {
+	int index = get_global_id(0);
+	int position = offset_start[0] + index;
+	int x = position % WINDOW_WIDTH;
+	int y = position / WINDOW_WIDTH;
+	
+	//Disk gap shrinks towards zero by the movement of the owner, sign tells if pixel was white
+	int owner = last_owner[index];
+	float margin = last_margin[index] - 2.0f * displacement;
+	float disk = last_disk[index];
+	float diskGap = fabs(disk) - displacement;
+	int ownerKept = margin > COHERENCE_SLACK && owner >= 0 && owner < SAT_COUNT;
+	if (ownerKept && diskGap > COHERENCE_SLACK){
+		last_margin[index] = margin;
+		last_disk[index] = copysign(diskGap, disk);
+		return;
+	}
+	
+	//First frame has infinite displacement and stored values are garbage, every pixel is sent
+	int wasWhite = disk < 0.0f;
+	int previousOwner = isinf(displacement) ? -1 : owner;
+	float shortestDistance;
+	if (ownerKept){
+		vector difference = {.x = x - satelites[owner].position.x, .y = y - satelites[owner].position.y};
+		shortestDistance = sqrt(difference.x * difference.x + difference.y * difference.y);
+		last_margin[index] = margin;
+	}
+	else{
+		float secondDistance = INFINITY;
+		shortestDistance = INFINITY;
+		owner = 0;
+		for(int j = 0; j < SAT_COUNT; ++j){
+			vector difference = {.x = x - satelites[j].position.x, .y = y - satelites[j].position.y};
+			float dist = sqrt(difference.x * difference.x + difference.y * difference.y);
+			if(dist < shortestDistance){
+				secondDistance = shortestDistance;
+				shortestDistance = dist;
+				owner = j;
+			}
+			else if(dist < secondDistance){
+				secondDistance = dist;
+			}
+		}
+		last_owner[index] = owner;
+		last_margin[index] = secondDistance - shortestDistance;
+	}
+	
+	//Sign of the difference is exact, negative only if shortestDistance < SAT_RADIUS
+	disk = shortestDistance - SAT_RADIUS;
+	last_disk[index] = disk;
+	int white = disk < 0.0f;
+	if (owner != previousOwner || white != wasWhite){
+		dirty[atomic_inc(dirty_count)] = DIRTY_ENTRY(index, white ? SAT_WHITE : owner);
+	}
+}
+
+// Run length encoded readback:
+// rows of the device share are encoded to runs of one sat_id so that host
+// reads only the runs. Run has sat_id in high 16 bits and length in low 16 bits.
+#define RLE_RUN(id, length) (((uint)(id) << 16) | (uint)(length))
+
+__kernel void rle_count(__global const sat_id *sat_ids, __global int *row_runs) {
+	int row = get_global_id(0);
+	__global const sat_id *ids = sat_ids + row * WINDOW_WIDTH;
+	int runs = 1;
+	for (int x = 1; x < WINDOW_WIDTH; x++){
+		runs += ids[x] != ids[x - 1];
+	}
+	row_runs[row] = runs;
+}
+
+//Rows are few, one work item scans them
+__kernel void rle_offsets(__global const int *row_runs, __global int *row_offsets, int rows) {
+	int sum = 0;
+	for (int r = 0; r < rows; r++){
+		row_offsets[r] = sum;
+		sum += row_runs[r];
+	}
+	row_offsets[rows] = sum;
+}
+
+__kernel void rle_write(__global const sat_id *sat_ids, __global const int *row_offsets, __global uint *runs) {
+	int row = get_global_id(0);
+	__global const sat_id *ids = sat_ids + row * WINDOW_WIDTH;
+	int run = row_offsets[row];
+	int start = 0;
+	for (int x = 1; x < WINDOW_WIDTH; x++){
+		if (ids[x] != ids[start]){
+			runs[run++] = RLE_RUN(ids[start], x - start);
+			start = x;
+		}
+	}
+	runs[run] = RLE_RUN(ids[start], WINDOW_WIDTH - start);
+}
+
+// Prefix sum utility:
+// exclusive scan of n ints. scan_blocks scans blocks of SCAN_GROUP items in
+// local memory and stores the block totals, host scans the totals with the
+// same kernels and scan_add adds the scanned totals back to the blocks.
+// Both kernels must be run with local size SCAN_GROUP.
+#define SCAN_GROUP 256
+
+__kernel void scan_blocks(__global const int *in, __global int *out, __global int *block_sums, int n) {
+	__local int temp[SCAN_GROUP];
+	int index = get_global_id(0);
+	int lid = get_local_id(0);
+	int value = index < n ? in[index] : 0;
+	temp[lid] = value;
+	barrier(CLK_LOCAL_MEM_FENCE);
+	
+	//Inclusive Hillis-Steele scan, log2(SCAN_GROUP) steps
+	for (int offset = 1; offset < SCAN_GROUP; offset <<= 1){
+		int add = lid >= offset ? temp[lid - offset] : 0;
+		barrier(CLK_LOCAL_MEM_FENCE);
+		temp[lid] += add;
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+	if (index < n){
+		out[index] = temp[lid] - value;
+	}
+	if (lid == SCAN_GROUP - 1){
+		block_sums[get_group_id(0)] = temp[lid];
+	}
+}
+
+__kernel void scan_add(__global int *out, __global const int *block_offsets, int n) {
+	int index = get_global_id(0);
+	if (index < n){
+		out[index] += block_offsets[get_group_id(0)];
+	}
+}
+
+// Delta frame readback:
+// previous sat_ids are kept on the device, changed pixels are flagged,
+// flags are scanned to output positions and changed pixels are compacted
+// to dirty_entry items of the dirty region mode. Host reads back only those.
+__kernel void delta_flags(__global const sat_id *sat_ids, __global const sat_id *previous_ids, __global int *flags, int all_changed) {
+	int index = get_global_id(0);
+	flags[index] = all_changed || sat_ids[index] != previous_ids[index];
+}
+
+__kernel void delta_scatter(__global const sat_id *sat_ids, __global sat_id *previous_ids, __global const int *flags, __global const int *offsets, __global dirty_entry *deltas, __global int *delta_count, int n) {
+	int index = get_global_id(0);
+	if (flags[index]){
+		deltas[offsets[index]] = DIRTY_ENTRY(index, sat_ids[index]);
+		previous_ids[index] = sat_ids[index];
+	}
+	if (index == n - 1){
+		delta_count[0] = offsets[index] + flags[index];
+	}
+}
+
+// Device physics:
+// one work item per satelite runs the Euler substeps of parallelPhysicsEngine
+// on the satelites kept on the device. Operations are done in the same order
+// and precision as on the host and the host builds the program with correctly
+// rounded division and sqrt, so every device ends up with the same positions.
+#define PHYSICS_UPDATES 10000
+
+__kernel void integrate(__global satelite *satelites, int delta_time) {
+	#pragma OPENCL FP_CONTRACT OFF
+	int i = get_global_id(0);
+	if (i >= SAT_COUNT){
+		return;
+	}
+	vector position = satelites[i].position;
+	vector velocity = satelites[i].velocity;
+	
+	//Gravity is evaluated once from the position at the start of the frame
+	vector to_black_hole = {.x = position.x - WINDOW_WIDTH / 2, .y = position.y - WINDOW_HEIGHT / 2};
+	float dist_squared = to_black_hole.x * to_black_hole.x + to_black_hole.y * to_black_hole.y;
+	float dist = sqrt(dist_squared);
+	vector direction = {.x = to_black_hole.x / dist, .y = to_black_hole.y / dist};
+	float accumulation = GRAVITY / dist_squared;
+	
+	for (int update = 0; update < PHYSICS_UPDATES; update++){
+		velocity.x -= accumulation * direction.x * delta_time / PHYSICS_UPDATES;
+		velocity.y -= accumulation * direction.y * delta_time / PHYSICS_UPDATES;
+		position.x = position.x + velocity.x * delta_time / PHYSICS_UPDATES;
+		position.y = position.y + velocity.y * delta_time / PHYSICS_UPDATES;
+	}
+	satelites[i].position = position;
+	satelites[i].velocity = velocity;
+}
+
+#ifdef GRAVITY_FIELD
+#define FIELD_CELL 4 //Must match FIELD_CELL in the host file
+#define FIELD_MARGIN (WINDOW_WIDTH / 2) //Must match FIELD_MARGIN in the host file
+#define FIELD_COLUMNS ((WINDOW_WIDTH + 2 * FIELD_MARGIN) / FIELD_CELL + 1)
+#define FIELD_ROWS ((WINDOW_HEIGHT + 2 * FIELD_MARGIN) / FIELD_CELL + 1)
+
+//Texels are read one by one, the sampler only fetches them
+__constant sampler_t field_sampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;
+
+//Bilinear sample of the field, positions outside it get the edge value.
+//Hardware linear filtering has low precision weights that differ between devices,
+//so weights are computed here with rounded operations only and all devices agree.
+float2 sampleGravityField(__read_only image2d_t field, float2 position) {
+	#pragma OPENCL FP_CONTRACT OFF
+	float2 cell = (position + FIELD_MARGIN) * (1.0f / FIELD_CELL);
+	cell = clamp(cell, (float2)(0.0f, 0.0f), (float2)(FIELD_COLUMNS - 1, FIELD_ROWS - 1));
+	int2 corner = min(convert_int2(cell), (int2)(FIELD_COLUMNS - 2, FIELD_ROWS - 2));
+	float2 weight = cell - convert_float2(corner);
+	float2 top_left = read_imagef(field, field_sampler, corner).xy;
+	float2 top_right = read_imagef(field, field_sampler, corner + (int2)(1, 0)).xy;
+	float2 bottom_left = read_imagef(field, field_sampler, corner + (int2)(0, 1)).xy;
+	float2 bottom_right = read_imagef(field, field_sampler, corner + (int2)(1, 1)).xy;
+	float2 top = top_left + weight.x * (top_right - top_left);
+	float2 bottom = bottom_left + weight.x * (bottom_right - bottom_left);
+	return top + weight.y * (bottom - top);
+}
+
+//Moves satelites through the precomputed field of all attractors, sampled again at every substep.
+__kernel void integrate_field(__global satelite *satelites, int delta_time, __read_only image2d_t field) {
+	#pragma OPENCL FP_CONTRACT OFF
+	int i = get_global_id(0);
+	if (i >= SAT_COUNT){
+		return;
+	}
+	vector position = satelites[i].position;
+	vector velocity = satelites[i].velocity;
+	float step = (float)delta_time / PHYSICS_UPDATES;
+	
+	//Substeps are summed from zero so that they are not lost against large positions
+	float2 moved = (float2)(0.0f, 0.0f);
+	float2 accelerated = (float2)(0.0f, 0.0f);
+	for (int update = 0; update < PHYSICS_UPDATES; update++){
+		accelerated += sampleGravityField(field, (float2)(position.x, position.y) + moved) * step;
+		moved += ((float2)(velocity.x, velocity.y) + accelerated) * step;
+	}
+	satelites[i].position.x = position.x + moved.x;
+	satelites[i].position.y = position.y + moved.y;
+	satelites[i].velocity.x = velocity.x + accelerated.x;
+	satelites[i].velocity.y = velocity.y + accelerated.y;
+}
+#endif
@@ -9,166 +9,2899 @@
 // prev and OpenMP:   gcc -o parallel parallel.c -std=c99 -lglut -lGL -lm -O3 -fopenmp
 // prev and OpenCL:   gcc -o parallel_orig parallel_orig.c -std=c99 -lglut -lGL -lm -O3 -fopenmp -lOpenCL
 
+// headless, no GL:   gcc -o parallel parallel.c -std=c99 -lm -O3 -fopenmp -DHEADLESS=1
+
 // Example compilation on macos X
 // no optimization:   gcc -o parallel parallel.c -std=c99 -framework GLUT -framework OpenGL
 // full optimization: gcc -o parallel parallel.c -std=c99 -framework GLUT -framework OpenGL -O3
 
-#ifdef _WIN32
-#include <windows.h>
-#endif
-#include <stdio.h> // printf
-#include <math.h> // INFINITY
-#include <stdlib.h>
+// clock_gettime of headless mode
+#define _POSIX_C_SOURCE 199309L
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <stdio.h> // printf
+#include <math.h> // INFINITY
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Define HEADLESS 1 to run frames without window or GL context, frame count
+// is given after the seed on command line
+#ifndef HEADLESS
+#define HEADLESS 0
+#endif
+#define HEADLESS_FRAMES 100
+
+// Window handling includes
+#if HEADLESS
+#include <time.h>
+#elif !defined(__APPLE__)
+#include <GL/gl.h>
+#include <GL/glut.h>
+#else
+#include <OpenGL/gl.h>
+#include <GLUT/glut.h>
+#endif
+// These are used to 8 the window size
+#define WINDOW_HEIGHT 1024
+#define WINDOW_WIDTH  1024
+
+// The number of satelites can be changed to see how it affects performance
+#ifndef SATELITE_COUNT
+#define SATELITE_COUNT 35
+#endif
+
+// These are used to control the satelite movement
+#define SATELITE_RADIUS 3.16f
+#define MAX_VELOCITY 0.1f
+#define GRAVITY 1.0f
+
+// Some helpers to window size variables
+#define SIZE WINDOW_HEIGHT*WINDOW_HEIGHT
+#define HORIZONTAL_CENTER (WINDOW_WIDTH / 2)
+#define VERTICAL_CENTER (WINDOW_HEIGHT / 2)
+
+// Is used to find out frame times
+int previousFrameTimeSinceStart = 0;
+unsigned int frameNumber = 0;
+unsigned int seed = 0;
+
+// Stores 2D data like the coordinates
+typedef struct{
+   float x;
+   float y;
+} vector;
+
+// Stores rendered colors. Each float may vary from 0.0f ... 1.0f
+typedef struct{
+   float red;
+   float green;
+   float blue;
+} color;
+
+// Stores the satelite data, which fly around black hole in the space
+typedef struct{
+   color identifier;
+   vector position;
+   vector velocity;
+} satelite;
+
+// Pixel buffer which is rendered to the screen
+color* pixels;
+
+// Pixel buffer which is used for error checking
+color* correctPixels;
+
+// Buffer for all satelites in the space
+satelite* satelites;
+
+// ## You may add your own variables here ##
+
+// Physics step in milliseconds given with --dt on command line, 0 uses frame time
+int fixedDeltaTime = 0;
+
+// Grid spacing in pixels given with --grid on command line. Satelites are snapped
+// to the grid and stopped so that many of them are exactly equally far from
+// pixels, which checks first index tie break of the engines. 0 keeps them as is.
+int tieGrid = 0;
+
+// Define which rendering engine is used
+#define BRUTE_FORCE 1
+#define DISTANCE_TRANSFORM 2
+#define BLOCK_FILL 3
+#define UNIFORM_GRID 4
+#define SIMD 5
+#define SCANLINE_SPANS 6
+#define DELAUNAY 7
+#ifndef RENDER_ENGINE
+#define RENDER_ENGINE BRUTE_FORCE // BRUTE_FORCE: every pixel checks all satelites, DISTANCE_TRANSFORM: lower envelope of parabolas per row,
+                                  // BLOCK_FILL: fill blocks whose corners share an owner, subdivide others,
+                                  // UNIFORM_GRID: search grid cells in rings around the pixel,
+                                  // SIMD: brute force over 4/8/16 pixels at once, best of SSE2/AVX2/AVX-512 is picked at runtime,
+                                  // SCANLINE_SPANS: fill owner spans of each row computed from the envelope,
+                                  // DELAUNAY: walk neighbours of a triangulation kept up to date with edge flips
+#endif
+
+// Define which integrator moves the satelites
+#define EULER_REFERENCE 1
+#define LEAPFROG 2
+#define RK4 3
+#define ADAPTIVE_RK 4
+#ifndef INTEGRATOR
+#define INTEGRATOR EULER_REFERENCE // EULER_REFERENCE: gravity once a frame and 10000 Euler updates, as in the exercise,
+                                   // LEAPFROG: velocity Verlet with INTEGRATOR_STEPS steps a frame,
+                                   // RK4: classic Runge-Kutta with INTEGRATOR_STEPS steps a frame,
+                                   // ADAPTIVE_RK: Dormand-Prince 5(4) with step size kept below INTEGRATOR_TOLERANCE
+#endif
+#ifndef INTEGRATOR_STEPS
+#define INTEGRATOR_STEPS 4
+#endif
+#ifndef INTEGRATOR_TOLERANCE
+// Allowed error of one adaptive step in pixels
+#define INTEGRATOR_TOLERANCE 1e-6
+#endif
+#if INTEGRATOR == ADAPTIVE_RK
+// Step size of every satelite is kept between frames, 0 until first frame
+double* integratorStep;
+#endif
+
+// Define SIMD_PHYSICS 1 to integrate 16/8/4 satelites at once in AVX-512/AVX/SSE2
+// lanes, best is picked at runtime
+#ifndef SIMD_PHYSICS
+#define SIMD_PHYSICS 0
+#endif
+#if SIMD_PHYSICS && INTEGRATOR != EULER_REFERENCE
+#error "SIMD_PHYSICS runs the Euler reference, it cannot be used with other integrators"
+#endif
+#if SIMD_PHYSICS
+// Satelite state as structure of arrays, padded to whole AVX-512 vectors
+#define PHYSICS_LANE_CAPACITY ((SATELITE_COUNT + 15) / 16 * 16)
+float* physicsPositionX;
+float* physicsPositionY;
+float* physicsVelocityX;
+float* physicsVelocityY;
+
+// Integrates satelites [first, first + simdPhysicsLanes) of the arrays for one frame
+void (*simdIntegrate)(int first, float deltaTime, float updates);
+int simdPhysicsLanes;
+void selectSimdIntegrate();
+#endif
+
+// Define PARAREAL_PHYSICS 1 to also split the substeps of every satelite to chunks
+// which are integrated in parallel and corrected until chunk boundaries stop moving
+#ifndef PARAREAL_PHYSICS
+#define PARAREAL_PHYSICS 0
+#endif
+#ifndef PARAREAL_CHUNKS
+// Chunks per satelite, 0 picks enough to give every thread a chunk
+#define PARAREAL_CHUNKS 0
+#endif
+#define PARAREAL_MAX_CHUNKS 64
+#ifndef PARAREAL_TOLERANCE
+// Largest move of a chunk boundary in pixels, velocity times frame time, that
+// ends the iteration. 0 iterates until the result equals the sequential one
+#define PARAREAL_TOLERANCE 0.0
+#endif
+#if PARAREAL_PHYSICS && (INTEGRATOR != EULER_REFERENCE || SIMD_PHYSICS)
+#error "PARAREAL_PHYSICS runs the scalar Euler reference, it cannot be used with other integrators or SIMD_PHYSICS"
+#endif
+// Define which gravity moves the satelites
+#define BLACK_HOLE 1
+#define DIRECT_SUM 2
+#define BARNES_HUT 3
+#ifndef GRAVITY_MODEL
+#define GRAVITY_MODEL BLACK_HOLE // BLACK_HOLE: only the black hole pulls satelites, as in the exercise,
+                                 // DIRECT_SUM: satelites also pull each other, every pair is summed,
+                                 // BARNES_HUT: as previous but far away groups pull from their quadtree cell
+#endif
+#ifndef SATELITE_GRAVITY
+// Gravity of one satelite, all of them together pull a tenth of the black hole
+#define SATELITE_GRAVITY (0.1 * GRAVITY / SATELITE_COUNT)
+#endif
+#define GRAVITY_SOFTENING SATELITE_RADIUS // Keeps close pairs from flinging each other away
+#ifndef GRAVITY_BATCHES
+// Forces are evaluated this many times a frame, substeps between use the same force
+#define GRAVITY_BATCHES 10
+#endif
+#ifndef BARNES_HUT_THETA
+// Cell pulls as a whole when its size is below this times its distance
+#define BARNES_HUT_THETA 0.5
+#endif
+#define BARNES_HUT_LEAF 8 // Satelites of a leaf are summed one by one
+#define BARNES_HUT_TASK 4096 // Smaller subtrees are built without new tasks
+#define MORTON_LEVELS 16
+#if GRAVITY_MODEL != BLACK_HOLE && (INTEGRATOR != EULER_REFERENCE || SIMD_PHYSICS || PARAREAL_PHYSICS)
+#error "DIRECT_SUM and BARNES_HUT have their own substep loop, they cannot be used with other integrators, SIMD_PHYSICS or PARAREAL_PHYSICS"
+#endif
+#if GRAVITY_MODEL != BLACK_HOLE
+// Acceleration of every satelite for the substeps of a batch
+double* accelerationX;
+double* accelerationY;
+#endif
+#if GRAVITY_MODEL == BARNES_HUT
+// Satelites sorted along Morton curve of the bounding square treeLeft, treeTop, treeSize
+unsigned int* mortonCode;
+int* mortonOrder;
+unsigned int* mortonScratch;
+int* mortonOrderScratch;
+int* radixCount; // 256 counters per thread
+double treeLeft;
+double treeTop;
+double treeSize;
+
+// Quadtree nodes, node 0 is the root. Node covers sorted satelites
+// treeNodeFirst ... treeNodeFirst + treeNodeCount - 1 in a cell of size
+// treeSize / 2^treeNodeLevel, missing children are -1
+int treeNodes;
+int* treeNodeFirst;
+int* treeNodeCount;
+int* treeNodeLevel;
+int* treeNodeChild;
+double* treeNodeX; // Center of mass
+double* treeNodeY;
+#endif
+
+// Define GRAVITY_FIELD 1 to replace the black hole term with a precomputed acceleration
+// field of all attractors, sampled bilinearly at every substep
+#ifndef GRAVITY_FIELD
+#define GRAVITY_FIELD 0
+#endif
+#ifndef ATTRACTOR_COUNT
+#define ATTRACTOR_COUNT 1 // Black hole in the center, others evenly on a ring around it
+#endif
+#define ATTRACTOR_RING 350.0
+#define ATTRACTOR_GRAVITY (0.25 * GRAVITY)
+#define FIELD_CELL 4 // Grid spacing in pixels
+#define FIELD_MARGIN (WINDOW_WIDTH / 2) // Field reaches this far outside the window, edge values beyond
+#define FIELD_COLUMNS ((WINDOW_WIDTH + 2 * FIELD_MARGIN) / FIELD_CELL + 1)
+#define FIELD_ROWS ((WINDOW_HEIGHT + 2 * FIELD_MARGIN) / FIELD_CELL + 1)
+#define FIELD_SOFTENING 0.5 // Pixels, keeps the field finite at attractors
+#define FIELD_BLOCK 64 // Satelites integrated together in vector lanes
+#if GRAVITY_FIELD && (INTEGRATOR != EULER_REFERENCE || SIMD_PHYSICS || PARAREAL_PHYSICS || GRAVITY_MODEL != BLACK_HOLE)
+#error "GRAVITY_FIELD has its own substep loop, it cannot be used with other integrators, SIMD_PHYSICS, PARAREAL_PHYSICS or mutual gravity"
+#endif
+#if GRAVITY_FIELD
+// Point mass whose gravity is summed to the field
+typedef struct{
+   double x;
+   double y;
+   double gravity;
+} attractor;
+attractor* attractors;
+
+// Acceleration at grid point (column, row), which is at pixel
+// (column * FIELD_CELL - FIELD_MARGIN, row * FIELD_CELL - FIELD_MARGIN)
+float* fieldX;
+float* fieldY;
+void buildGravityField();
+#endif
+
+#if PARAREAL_PHYSICS
+// Satelite state at a chunk boundary, in the floats of the reference
+typedef struct{
+   vector position;
+   vector velocity;
+} pararealState;
+
+// Coarse prediction of a chunk end
+typedef struct{
+   double x;
+   double y;
+   double vx;
+   double vy;
+} pararealPrediction;
+
+int pararealChunks;
+// Boundary n of satelite i is at i * (pararealChunks + 1) + n, chunk results at i * pararealChunks + n
+pararealState* pararealBoundary;
+pararealState* pararealFine;
+pararealPrediction* pararealCoarse;
+// Set when start of the chunk has moved after its fine result was computed
+unsigned char* pararealStale;
+// Velocity change of one substep, constant during a frame
+vector* pararealKick;
+#endif
+
+#if RENDER_ENGINE == BLOCK_FILL
+// Top level block size and the size below which blocks are rendered pixel by pixel
+#define BLOCK_SIZE 32
+#define MIN_BLOCK_SIZE 4
+#endif
+
+#if RENDER_ENGINE == DISTANCE_TRANSFORM || RENDER_ENGINE == SCANLINE_SPANS
+// Satelite indices sorted by x-coordinate, ties by index
+int* sortedSatelites;
+// Position of every satelite in sortedSatelites
+int* sortedPosition;
+
+// Column bucket start offsets used for counting sort of satelites
+int* columnStart;
+
+// Per thread lower envelope of one row: owner satelite, parabola vertex,
+// parabola height and left boundary of the segment
+int* envelopeOwner;
+double* envelopeVertex;
+double* envelopeHeight;
+double* envelopeBoundary;
+#endif
+
+#if RENDER_ENGINE == UNIFORM_GRID
+// Uniform grid over the window rebuilt every frame with counting sort.
+// Satelites of cell c are gridSatelites[gridCellStart[c] ... gridCellStart[c + 1] - 1]
+// in index order, satelites outside the window are clamped to edge cells.
+// Coarse blocks of GRID_BLOCK x GRID_BLOCK cells count their satelites so
+// that ring search can jump over empty space far from the satelites.
+#define GRID_BLOCK 16
+int gridColumns;
+int gridRows;
+int gridCellSize;
+int gridBlockColumns;
+int gridBlockRows;
+int* gridCellStart;
+int* gridSatelites;
+int* gridBlockCount;
+#endif
+
+#if RENDER_ENGINE == SIMD
+// Satelite positions as structure of arrays for vector loads
+float* sateliteX;
+float* sateliteY;
+
+// Renders pixels [x0, x0 + count) of a row with the widest supported instruction set
+void (*simdRenderRow)(int y, int x0, int count);
+void selectSimdRenderRow();
+#endif
+
+#if RENDER_ENGINE == DELAUNAY
+// Delaunay triangulation of the satelites and three far away vertices
+// SATELITE_COUNT ... SATELITE_COUNT + 2 enclosing them, kept between frames.
+// Vertices of triangle t are triangleVertex[3 * t ... 3 * t + 2] counter
+// clockwise and triangleNeighbor[3 * t + i] is the triangle across the edge
+// opposite to vertex i, -1 if none. Satelites at the same position as a lower
+// index satelite are left out since they can never own a pixel.
+#define TRIANGLE_CAPACITY (2 * SATELITE_COUNT + 8)
+
+// Kinetic update gives up and rebuilds after this many steps in one frame
+#define KINETIC_STEP_LIMIT 16
+// Equally far satelites followed at the end of a walk before all are checked
+#define DELAUNAY_TIES 64
+int* triangleVertex;
+int* triangleNeighbor;
+int triangleCount;
+int triangulationValid = 0;
+int* duplicateOf;
+
+// Vertex positions the triangulation is valid for, satelites are moved from
+// these to their current positions when the triangulation is updated
+double* vertexPositionX;
+double* vertexPositionY;
+double* startPositionX;
+double* startPositionY;
+
+// Delaunay neighbours of satelite j are neighborList[neighborStart[j] ... neighborStart[j + 1] - 1]
+int* neighborStart;
+int* neighborList;
+
+// Work arrays of insertion and edge flipping. Satelites are inserted stripe
+// by stripe, up one stripe and down the next, so that consecutive satelites
+// are near each other and locating them is a short walk.
+int* insertOrder;
+double stripeLeft;
+double stripeWidth;
+int* triangleMark;
+int markStamp = 0;
+int* cavity;
+int* boundaryA;
+int* boundaryB;
+int* boundaryOuter;
+int* newTriangles;
+#endif
+
+// ## You may add your own initialization routines here ##
+void init(){
+   if(tieGrid > 0){
+      for(int i = 0; i < SATELITE_COUNT; ++i){
+         satelites[i].position.x = roundf(satelites[i].position.x / tieGrid) * tieGrid;
+         satelites[i].position.y = roundf(satelites[i].position.y / tieGrid) * tieGrid;
+         satelites[i].velocity.x = 0.0f;
+         satelites[i].velocity.y = 0.0f;
+      }
+   }
+#if RENDER_ENGINE == DISTANCE_TRANSFORM || RENDER_ENGINE == SCANLINE_SPANS
+   int threads = omp_get_max_threads();
+   sortedSatelites = (int*)malloc(sizeof(int) * SATELITE_COUNT);
+   sortedPosition = (int*)malloc(sizeof(int) * SATELITE_COUNT);
+   columnStart = (int*)malloc(sizeof(int) * (WINDOW_WIDTH + 3));
+   envelopeOwner = (int*)malloc(sizeof(int) * SATELITE_COUNT * threads);
+   envelopeVertex = (double*)malloc(sizeof(double) * SATELITE_COUNT * threads);
+   envelopeHeight = (double*)malloc(sizeof(double) * SATELITE_COUNT * threads);
+   envelopeBoundary = (double*)malloc(sizeof(double) * (SATELITE_COUNT + 1) * threads);
+#endif
+#if RENDER_ENGINE == UNIFORM_GRID
+   // About two satelites per cell if they covered the window, at least 2 pixels
+   gridCellSize = (int)ceil(WINDOW_WIDTH / sqrt(SATELITE_COUNT / 2.0 + 1.0));
+   if(gridCellSize < 2){
+      gridCellSize = 2;
+   }
+   gridColumns = (WINDOW_WIDTH + gridCellSize - 1) / gridCellSize;
+   gridRows = (WINDOW_HEIGHT + gridCellSize - 1) / gridCellSize;
+   gridBlockColumns = (gridColumns + GRID_BLOCK - 1) / GRID_BLOCK;
+   gridBlockRows = (gridRows + GRID_BLOCK - 1) / GRID_BLOCK;
+   gridCellStart = (int*)malloc(sizeof(int) * (gridColumns * gridRows + 1));
+   gridSatelites = (int*)malloc(sizeof(int) * SATELITE_COUNT);
+   gridBlockCount = (int*)malloc(sizeof(int) * gridBlockColumns * gridBlockRows);
+#endif
+#if RENDER_ENGINE == SIMD
+   sateliteX = (float*)_mm_malloc(sizeof(float) * SATELITE_COUNT, 64);
+   sateliteY = (float*)_mm_malloc(sizeof(float) * SATELITE_COUNT, 64);
+   selectSimdRenderRow();
+#endif
+#if RENDER_ENGINE == DELAUNAY
+   triangleVertex = (int*)malloc(sizeof(int) * 3 * TRIANGLE_CAPACITY);
+   triangleNeighbor = (int*)malloc(sizeof(int) * 3 * TRIANGLE_CAPACITY);
+   duplicateOf = (int*)malloc(sizeof(int) * SATELITE_COUNT);
+   vertexPositionX = (double*)malloc(sizeof(double) * (SATELITE_COUNT + 3));
+   vertexPositionY = (double*)malloc(sizeof(double) * (SATELITE_COUNT + 3));
+   startPositionX = (double*)malloc(sizeof(double) * SATELITE_COUNT);
+   startPositionY = (double*)malloc(sizeof(double) * SATELITE_COUNT);
+   neighborStart = (int*)malloc(sizeof(int) * (SATELITE_COUNT + 1));
+   neighborList = (int*)malloc(sizeof(int) * 3 * TRIANGLE_CAPACITY);
+   insertOrder = (int*)malloc(sizeof(int) * SATELITE_COUNT);
+   triangleMark = (int*)calloc(TRIANGLE_CAPACITY, sizeof(int));
+   cavity = (int*)malloc(sizeof(int) * TRIANGLE_CAPACITY);
+   boundaryA = (int*)malloc(sizeof(int) * (TRIANGLE_CAPACITY + 2));
+   boundaryB = (int*)malloc(sizeof(int) * (TRIANGLE_CAPACITY + 2));
+   boundaryOuter = (int*)malloc(sizeof(int) * (TRIANGLE_CAPACITY + 2));
+   newTriangles = (int*)malloc(sizeof(int) * (TRIANGLE_CAPACITY + 2));
+#endif
+#if INTEGRATOR == ADAPTIVE_RK
+   integratorStep = (double*)calloc(SATELITE_COUNT, sizeof(double));
+#endif
+#if SIMD_PHYSICS
+   physicsPositionX = (float*)_mm_malloc(sizeof(float) * PHYSICS_LANE_CAPACITY, 64);
+   physicsPositionY = (float*)_mm_malloc(sizeof(float) * PHYSICS_LANE_CAPACITY, 64);
+   physicsVelocityX = (float*)_mm_malloc(sizeof(float) * PHYSICS_LANE_CAPACITY, 64);
+   physicsVelocityY = (float*)_mm_malloc(sizeof(float) * PHYSICS_LANE_CAPACITY, 64);
+   selectSimdIntegrate();
+#endif
+#if PARAREAL_PHYSICS
+   pararealChunks = PARAREAL_CHUNKS > 0 ? PARAREAL_CHUNKS :
+      (omp_get_max_threads() + SATELITE_COUNT - 1) / SATELITE_COUNT;
+   if(pararealChunks > PARAREAL_MAX_CHUNKS){
+      pararealChunks = PARAREAL_MAX_CHUNKS;
+   }
+   printf("Parareal physics: %i chunks per satelite\n", pararealChunks);
+   pararealBoundary = (pararealState*)malloc(sizeof(pararealState) * SATELITE_COUNT * (pararealChunks + 1));
+   pararealFine = (pararealState*)malloc(sizeof(pararealState) * SATELITE_COUNT * pararealChunks);
+   pararealCoarse = (pararealPrediction*)malloc(sizeof(pararealPrediction) * SATELITE_COUNT * pararealChunks);
+   pararealKick = (vector*)malloc(sizeof(vector) * SATELITE_COUNT);
+   pararealStale = (unsigned char*)malloc(SATELITE_COUNT * pararealChunks);
+#endif
+#if GRAVITY_FIELD
+   attractors = (attractor*)malloc(sizeof(attractor) * ATTRACTOR_COUNT);
+   attractors[0].x = HORIZONTAL_CENTER;
+   attractors[0].y = VERTICAL_CENTER;
+   attractors[0].gravity = GRAVITY;
+   double ringStep = 2.0 * acos(-1.0) / (ATTRACTOR_COUNT > 1 ? ATTRACTOR_COUNT - 1 : 1);
+   for(int a = 1; a < ATTRACTOR_COUNT; ++a){
+      double angle = ringStep * a;
+      attractors[a].x = HORIZONTAL_CENTER + ATTRACTOR_RING * cos(angle);
+      attractors[a].y = VERTICAL_CENTER + ATTRACTOR_RING * sin(angle);
+      attractors[a].gravity = ATTRACTOR_GRAVITY;
+   }
+   fieldX = (float*)malloc(sizeof(float) * FIELD_COLUMNS * FIELD_ROWS);
+   fieldY = (float*)malloc(sizeof(float) * FIELD_COLUMNS * FIELD_ROWS);
+   buildGravityField();
+#endif
+#if GRAVITY_MODEL != BLACK_HOLE
+   accelerationX = (double*)malloc(sizeof(double) * SATELITE_COUNT);
+   accelerationY = (double*)malloc(sizeof(double) * SATELITE_COUNT);
+#endif
+#if GRAVITY_MODEL == BARNES_HUT
+   mortonCode = (unsigned int*)malloc(sizeof(unsigned int) * SATELITE_COUNT);
+   mortonOrder = (int*)malloc(sizeof(int) * SATELITE_COUNT);
+   mortonScratch = (unsigned int*)malloc(sizeof(unsigned int) * SATELITE_COUNT);
+   mortonOrderScratch = (int*)malloc(sizeof(int) * SATELITE_COUNT);
+   radixCount = (int*)malloc(sizeof(int) * 256 * omp_get_max_threads());
+   treeNodeFirst = (int*)malloc(sizeof(int) * 2 * SATELITE_COUNT);
+   treeNodeCount = (int*)malloc(sizeof(int) * 2 * SATELITE_COUNT);
+   treeNodeLevel = (int*)malloc(sizeof(int) * 2 * SATELITE_COUNT);
+   treeNodeChild = (int*)malloc(sizeof(int) * 8 * SATELITE_COUNT);
+   treeNodeX = (double*)malloc(sizeof(double) * 2 * SATELITE_COUNT);
+   treeNodeY = (double*)malloc(sizeof(double) * 2 * SATELITE_COUNT);
+#endif
+}
+
+#if INTEGRATOR != EULER_REFERENCE
+// Position and velocity of one satelite in double precision
+typedef struct{
+   double x;
+   double y;
+   double vx;
+   double vy;
+} orbit;
+
+// Time derivative of the orbit: velocity and gravity of the black hole,
+// same force as in the Euler reference
+orbit orbitDerivative(orbit state){
+   double dx = state.x - HORIZONTAL_CENTER;
+   double dy = state.y - VERTICAL_CENTER;
+   double distSquared = dx * dx + dy * dy;
+   double scale = -GRAVITY / (distSquared * sqrt(distSquared));
+   orbit derivative = {.x = state.vx, .y = state.vy,
+                       .vx = dx * scale, .vy = dy * scale};
+   return derivative;
+}
+
+// state + h * derivative
+orbit orbitStep(orbit state, orbit derivative, double h){
+   orbit result = {.x = state.x + h * derivative.x, .y = state.y + h * derivative.y,
+                   .vx = state.vx + h * derivative.vx, .vy = state.vy + h * derivative.vy};
+   return result;
+}
+
+orbit loadOrbit(int i){
+   orbit state = {.x = satelites[i].position.x, .y = satelites[i].position.y,
+                  .vx = satelites[i].velocity.x, .vy = satelites[i].velocity.y};
+   return state;
+}
+
+void storeOrbit(int i, orbit state){
+   satelites[i].position.x = state.x;
+   satelites[i].position.y = state.y;
+   satelites[i].velocity.x = state.vx;
+   satelites[i].velocity.y = state.vy;
+}
+#endif
+
+#if INTEGRATOR == LEAPFROG
+// Velocity Verlet (kick-drift-kick), gravity at the end of a step is reused
+// at the start of the next one, so a frame takes INTEGRATOR_STEPS + 1 evaluations
+void integrateSatelite(int i, double deltaTime){
+   double h = deltaTime / INTEGRATOR_STEPS;
+   orbit state = loadOrbit(i);
+   orbit derivative = orbitDerivative(state);
+   for(int step = 0; step < INTEGRATOR_STEPS; ++step){
+      state.vx += 0.5 * h * derivative.vx;
+      state.vy += 0.5 * h * derivative.vy;
+      state.x += h * state.vx;
+      state.y += h * state.vy;
+      derivative = orbitDerivative(state);
+      state.vx += 0.5 * h * derivative.vx;
+      state.vy += 0.5 * h * derivative.vy;
+   }
+   storeOrbit(i, state);
+}
+#endif
+
+#if INTEGRATOR == RK4
+// Classic fourth order Runge-Kutta, four evaluations per step
+void integrateSatelite(int i, double deltaTime){
+   double h = deltaTime / INTEGRATOR_STEPS;
+   orbit state = loadOrbit(i);
+   for(int step = 0; step < INTEGRATOR_STEPS; ++step){
+      orbit k1 = orbitDerivative(state);
+      orbit k2 = orbitDerivative(orbitStep(state, k1, 0.5 * h));
+      orbit k3 = orbitDerivative(orbitStep(state, k2, 0.5 * h));
+      orbit k4 = orbitDerivative(orbitStep(state, k3, h));
+      state.x += h / 6.0 * (k1.x + 2.0 * k2.x + 2.0 * k3.x + k4.x);
+      state.y += h / 6.0 * (k1.y + 2.0 * k2.y + 2.0 * k3.y + k4.y);
+      state.vx += h / 6.0 * (k1.vx + 2.0 * k2.vx + 2.0 * k3.vx + k4.vx);
+      state.vy += h / 6.0 * (k1.vy + 2.0 * k2.vy + 2.0 * k3.vy + k4.vy);
+   }
+   storeOrbit(i, state);
+}
+#endif
+
+#if INTEGRATOR == ADAPTIVE_RK
+// Dormand-Prince 5(4) tableau: stage coefficients, fifth order weights
+// (same as the last stage) and difference to the fourth order weights
+const double dormandPrinceA[7][6] = {
+   {0},
+   {1.0 / 5.0},
+   {3.0 / 40.0, 9.0 / 40.0},
+   {44.0 / 45.0, -56.0 / 15.0, 32.0 / 9.0},
+   {19372.0 / 6561.0, -25360.0 / 2187.0, 64448.0 / 6561.0, -212.0 / 729.0},
+   {9017.0 / 3168.0, -355.0 / 33.0, 46732.0 / 5247.0, 49.0 / 176.0, -5103.0 / 18656.0},
+   {35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0, -2187.0 / 6784.0, 11.0 / 84.0}};
+const double dormandPrinceError[7] = {71.0 / 57600.0, 0.0, -71.0 / 16695.0, 71.0 / 1920.0,
+   -17253.0 / 339200.0, 22.0 / 525.0, -1.0 / 40.0};
+
+// Embedded Runge-Kutta with step size control. Error of a step is the
+// position error plus velocity error over the step, in pixels. Last stage is
+// the derivative at the accepted state and starts the next step
+void integrateSatelite(int i, double deltaTime){
+   orbit state = loadOrbit(i);
+   orbit k[7];
+   k[0] = orbitDerivative(state);
+   double h = integratorStep[i] > 0.0 ? integratorStep[i] : deltaTime;
+   double time = 0.0;
+   while(time < deltaTime){
+      int lastStep = time + h >= deltaTime;
+      double stepSize = lastStep ? deltaTime - time : h;
+      orbit next = state;
+      for(int s = 1; s < 7; ++s){
+         orbit stage = state;
+         for(int j = 0; j < s; ++j){
+            stage = orbitStep(stage, k[j], stepSize * dormandPrinceA[s][j]);
+         }
+         k[s] = orbitDerivative(stage);
+         next = stage;
+      }
+      orbit error = {0};
+      for(int s = 0; s < 7; ++s){
+         error = orbitStep(error, k[s], stepSize * dormandPrinceError[s]);
+      }
+      double positionError = sqrt(error.x * error.x + error.y * error.y);
+      double velocityError = sqrt(error.vx * error.vx + error.vy * error.vy) * stepSize;
+      double ratio = fmax(positionError, velocityError) / INTEGRATOR_TOLERANCE;
+
+      // Grow at most 5x and shrink at most 5x per step
+      double scale = ratio > 0.0 ? 0.9 * pow(ratio, -0.2) : 5.0;
+      scale = fmin(5.0, fmax(0.2, scale));
+      if(ratio <= 1.0 || stepSize < deltaTime * 1e-9){
+         time = lastStep ? deltaTime : time + stepSize;
+         state = next;
+         k[0] = k[6];
+         // Shortened last step does not limit the next frame
+         if(!lastStep || scale < 1.0){
+            h = stepSize * scale;
+         }
+      }
+      else{
+         h = stepSize * scale;
+      }
+   }
+   integratorStep[i] = h;
+   storeOrbit(i, state);
+}
+#endif
+
+
+#if SIMD_PHYSICS
+// Euler reference for a vector of satelites. Lanes do the same operations
+// in the same order as the scalar loop, division included, so they give the
+// same floats. Velocity change of a substep does not change during a frame
+// and is computed once, like the compiler does for the scalar loop.
+__attribute__((target("avx512f")))
+void integrateLanesAvx512(int first, float deltaTime, float updates){
+   __m512 x = _mm512_load_ps(physicsPositionX + first);
+   __m512 y = _mm512_load_ps(physicsPositionY + first);
+   __m512 vx = _mm512_load_ps(physicsVelocityX + first);
+   __m512 vy = _mm512_load_ps(physicsVelocityY + first);
+   __m512 timeStep = _mm512_set1_ps(deltaTime);
+   __m512 updateCount = _mm512_set1_ps(updates);
+   __m512 dx = _mm512_sub_ps(x, _mm512_set1_ps(HORIZONTAL_CENTER));
+   __m512 dy = _mm512_sub_ps(y, _mm512_set1_ps(VERTICAL_CENTER));
+   __m512 distSquared = _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy));
+   __m512 dist = _mm512_sqrt_ps(distSquared);
+   __m512 accumulation = _mm512_div_ps(_mm512_set1_ps(GRAVITY), distSquared);
+   __m512 kickX = _mm512_div_ps(_mm512_mul_ps(_mm512_mul_ps(accumulation, _mm512_div_ps(dx, dist)), timeStep), updateCount);
+   __m512 kickY = _mm512_div_ps(_mm512_mul_ps(_mm512_mul_ps(accumulation, _mm512_div_ps(dy, dist)), timeStep), updateCount);
+   for(int update = 0; update < (int)updates; ++update){
+      vx = _mm512_sub_ps(vx, kickX);
+      vy = _mm512_sub_ps(vy, kickY);
+      x = _mm512_add_ps(x, _mm512_div_ps(_mm512_mul_ps(vx, timeStep), updateCount));
+      y = _mm512_add_ps(y, _mm512_div_ps(_mm512_mul_ps(vy, timeStep), updateCount));
+   }
+   _mm512_store_ps(physicsPositionX + first, x);
+   _mm512_store_ps(physicsPositionY + first, y);
+   _mm512_store_ps(physicsVelocityX + first, vx);
+   _mm512_store_ps(physicsVelocityY + first, vy);
+}
+
+__attribute__((target("avx")))
+void integrateLanesAvx(int first, float deltaTime, float updates){
+   __m256 x = _mm256_load_ps(physicsPositionX + first);
+   __m256 y = _mm256_load_ps(physicsPositionY + first);
+   __m256 vx = _mm256_load_ps(physicsVelocityX + first);
+   __m256 vy = _mm256_load_ps(physicsVelocityY + first);
+   __m256 timeStep = _mm256_set1_ps(deltaTime);
+   __m256 updateCount = _mm256_set1_ps(updates);
+   __m256 dx = _mm256_sub_ps(x, _mm256_set1_ps(HORIZONTAL_CENTER));
+   __m256 dy = _mm256_sub_ps(y, _mm256_set1_ps(VERTICAL_CENTER));
+   __m256 distSquared = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+   __m256 dist = _mm256_sqrt_ps(distSquared);
+   __m256 accumulation = _mm256_div_ps(_mm256_set1_ps(GRAVITY), distSquared);
+   __m256 kickX = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(accumulation, _mm256_div_ps(dx, dist)), timeStep), updateCount);
+   __m256 kickY = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(accumulation, _mm256_div_ps(dy, dist)), timeStep), updateCount);
+   for(int update = 0; update < (int)updates; ++update){
+      vx = _mm256_sub_ps(vx, kickX);
+      vy = _mm256_sub_ps(vy, kickY);
+      x = _mm256_add_ps(x, _mm256_div_ps(_mm256_mul_ps(vx, timeStep), updateCount));
+      y = _mm256_add_ps(y, _mm256_div_ps(_mm256_mul_ps(vy, timeStep), updateCount));
+   }
+   _mm256_store_ps(physicsPositionX + first, x);
+   _mm256_store_ps(physicsPositionY + first, y);
+   _mm256_store_ps(physicsVelocityX + first, vx);
+   _mm256_store_ps(physicsVelocityY + first, vy);
+}
+
+void integrateLanesSse2(int first, float deltaTime, float updates){
+   __m128 x = _mm_load_ps(physicsPositionX + first);
+   __m128 y = _mm_load_ps(physicsPositionY + first);
+   __m128 vx = _mm_load_ps(physicsVelocityX + first);
+   __m128 vy = _mm_load_ps(physicsVelocityY + first);
+   __m128 timeStep = _mm_set1_ps(deltaTime);
+   __m128 updateCount = _mm_set1_ps(updates);
+   __m128 dx = _mm_sub_ps(x, _mm_set1_ps(HORIZONTAL_CENTER));
+   __m128 dy = _mm_sub_ps(y, _mm_set1_ps(VERTICAL_CENTER));
+   __m128 distSquared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+   __m128 dist = _mm_sqrt_ps(distSquared);
+   __m128 accumulation = _mm_div_ps(_mm_set1_ps(GRAVITY), distSquared);
+   __m128 kickX = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(accumulation, _mm_div_ps(dx, dist)), timeStep), updateCount);
+   __m128 kickY = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(accumulation, _mm_div_ps(dy, dist)), timeStep), updateCount);
+   for(int update = 0; update < (int)updates; ++update){
+      vx = _mm_sub_ps(vx, kickX);
+      vy = _mm_sub_ps(vy, kickY);
+      x = _mm_add_ps(x, _mm_div_ps(_mm_mul_ps(vx, timeStep), updateCount));
+      y = _mm_add_ps(y, _mm_div_ps(_mm_mul_ps(vy, timeStep), updateCount));
+   }
+   _mm_store_ps(physicsPositionX + first, x);
+   _mm_store_ps(physicsPositionY + first, y);
+   _mm_store_ps(physicsVelocityX + first, vx);
+   _mm_store_ps(physicsVelocityY + first, vy);
+}
+
+// Picks the widest instruction set supported by the CPU
+void selectSimdIntegrate(){
+   __builtin_cpu_init();
+   if(__builtin_cpu_supports("avx512f")){
+      printf("SIMD physics engine: AVX-512\n");
+      simdIntegrate = integrateLanesAvx512;
+      simdPhysicsLanes = 16;
+   }
+   else if(__builtin_cpu_supports("avx")){
+      printf("SIMD physics engine: AVX\n");
+      simdIntegrate = integrateLanesAvx;
+      simdPhysicsLanes = 8;
+   }
+   else{
+      printf("SIMD physics engine: SSE2\n");
+      simdIntegrate = integrateLanesSse2;
+      simdPhysicsLanes = 4;
+   }
+}
+
+// Satelites are copied to the arrays, integrated a vector at a time in
+// registers and written back once a frame
+void simdPhysicsEngine(int deltaTime, int updates){
+   for(int i = 0; i < PHYSICS_LANE_CAPACITY; ++i){
+      // Padding lanes repeat the last satelite and are not written back
+      int j = i < SATELITE_COUNT ? i : SATELITE_COUNT - 1;
+      physicsPositionX[i] = satelites[j].position.x;
+      physicsPositionY[i] = satelites[j].position.y;
+      physicsVelocityX[i] = satelites[j].velocity.x;
+      physicsVelocityY[i] = satelites[j].velocity.y;
+   }
+
+   #pragma omp parallel for schedule(static)
+   for(int first = 0; first < SATELITE_COUNT; first += simdPhysicsLanes){
+      simdIntegrate(first, deltaTime, updates);
+   }
+
+   for(int i = 0; i < SATELITE_COUNT; ++i){
+      satelites[i].position.x = physicsPositionX[i];
+      satelites[i].position.y = physicsPositionY[i];
+      satelites[i].velocity.x = physicsVelocityX[i];
+      satelites[i].velocity.y = physicsVelocityY[i];
+   }
+}
+#endif
+
+#if PARAREAL_PHYSICS
+// Fine solver: substeps [first, last) of the reference loop
+pararealState pararealFineSolve(pararealState state, vector kick, int deltaTime, int updates, int first, int last){
+   for(int physicsUpdateIndex = first; physicsUpdateIndex < last; ++physicsUpdateIndex){
+      state.velocity.x -= kick.x;
+      state.velocity.y -= kick.y;
+      state.position.x = state.position.x + state.velocity.x * deltaTime / updates;
+      state.position.y = state.position.y + state.velocity.y * deltaTime / updates;
+   }
+   return state;
+}
+
+// Coarse solver: the same substeps in closed form. Gravity is constant during
+// a frame, so velocity changes by the kick every substep and position by
+// the sum of the velocities. Differs from the fine solver only by rounding.
+pararealPrediction pararealCoarseSolve(pararealState state, vector kick, double stepTime, int substeps){
+   double m = substeps;
+   pararealPrediction prediction = {
+      .x = state.position.x + stepTime * (m * state.velocity.x - kick.x * m * (m + 1.0) / 2.0),
+      .y = state.position.y + stepTime * (m * state.velocity.y - kick.y * m * (m + 1.0) / 2.0),
+      .vx = state.velocity.x - m * kick.x,
+      .vy = state.velocity.y - m * kick.y};
+   return prediction;
+}
+
+// Parareal over the substeps of all satelites. Coarse solver predicts the
+// chunk boundaries, fine solver integrates all chunks in parallel from them
+// and a serial coarse sweep along every satelite propagates the corrections.
+// Correction is added as fine + (new coarse - old coarse), so a boundary
+// whose start did not move gets the fine result exactly: after iteration k
+// the first k chunks equal the sequential loop, and only chunks whose start
+// has moved are integrated again.
+void pararealPhysicsEngine(int deltaTime, int updates){
+   const int chunks = pararealChunks;
+   const int stride = chunks + 1;
+   const double stepTime = (double)deltaTime / updates;
+
+   // Gravity force as in the reference and coarse guess of all boundaries
+   #pragma omp parallel for
+   for(int i = 0; i < SATELITE_COUNT; ++i){
+      vector positionToBlackHole = {.x = satelites[i].position.x -
+         HORIZONTAL_CENTER, .y = satelites[i].position.y - VERTICAL_CENTER};
+      float distToBlackHoleSquared =
+         positionToBlackHole.x * positionToBlackHole.x +
+         positionToBlackHole.y * positionToBlackHole.y;
+      float distToBlackHole = sqrt(distToBlackHoleSquared);
+      vector normalizedDirection = {
+         .x = positionToBlackHole.x / distToBlackHole,
+         .y = positionToBlackHole.y / distToBlackHole};
+      float accumulation = GRAVITY / distToBlackHoleSquared;
+      pararealKick[i].x = accumulation * normalizedDirection.x * deltaTime / updates;
+      pararealKick[i].y = accumulation * normalizedDirection.y * deltaTime / updates;
+
+      pararealState* boundary = pararealBoundary + i * stride;
+      boundary[0].position = satelites[i].position;
+      boundary[0].velocity = satelites[i].velocity;
+      for(int n = 0; n < chunks; ++n){
+         pararealPrediction prediction = pararealCoarseSolve(boundary[n], pararealKick[i], stepTime,
+            (n + 1) * updates / chunks - n * updates / chunks);
+         pararealCoarse[i * chunks + n] = prediction;
+         pararealStale[i * chunks + n] = 1;
+         boundary[n + 1].position.x = prediction.x;
+         boundary[n + 1].position.y = prediction.y;
+         boundary[n + 1].velocity.x = prediction.vx;
+         boundary[n + 1].velocity.y = prediction.vy;
+      }
+   }
+
+   for(int iteration = 0; iteration < chunks; ++iteration){
+      #pragma omp parallel for collapse(2) schedule(dynamic)
+      for(int i = 0; i < SATELITE_COUNT; ++i){
+         for(int n = iteration; n < chunks; ++n){
+            if(!pararealStale[i * chunks + n]){
+               continue;
+            }
+            pararealStale[i * chunks + n] = 0;
+            pararealFine[i * chunks + n] = pararealFineSolve(pararealBoundary[i * stride + n], pararealKick[i],
+               deltaTime, updates, n * updates / chunks, (n + 1) * updates / chunks);
+         }
+      }
+
+      double largestMove = 0.0;
+      #pragma omp parallel for reduction(max:largestMove)
+      for(int i = 0; i < SATELITE_COUNT; ++i){
+         pararealState* boundary = pararealBoundary + i * stride;
+         for(int n = iteration; n < chunks; ++n){
+            pararealPrediction prediction = pararealCoarseSolve(boundary[n], pararealKick[i], stepTime,
+               (n + 1) * updates / chunks - n * updates / chunks);
+            pararealPrediction previous = pararealCoarse[i * chunks + n];
+            pararealState fine = pararealFine[i * chunks + n];
+            pararealState corrected;
+            corrected.position.x = fine.position.x + (prediction.x - previous.x);
+            corrected.position.y = fine.position.y + (prediction.y - previous.y);
+            corrected.velocity.x = fine.velocity.x + (prediction.vx - previous.vx);
+            corrected.velocity.y = fine.velocity.y + (prediction.vy - previous.vy);
+            pararealCoarse[i * chunks + n] = prediction;
+
+            double move = fmax(fabs(corrected.position.x - boundary[n + 1].position.x),
+               fabs(corrected.position.y - boundary[n + 1].position.y));
+            move = fmax(move, deltaTime * fmax(fabs(corrected.velocity.x - boundary[n + 1].velocity.x),
+               fabs(corrected.velocity.y - boundary[n + 1].velocity.y)));
+            largestMove = fmax(largestMove, move);
+            if(n + 1 < chunks && move != 0.0){
+               pararealStale[i * chunks + n + 1] = 1;
+            }
+            boundary[n + 1] = corrected;
+         }
+      }
+      if(largestMove <= PARAREAL_TOLERANCE){
+         break;
+      }
+   }
+
+   for(int i = 0; i < SATELITE_COUNT; ++i){
+      satelites[i].position = pararealBoundary[i * stride + chunks].position;
+      satelites[i].velocity = pararealBoundary[i * stride + chunks].velocity;
+   }
+}
+#endif
+
+#if GRAVITY_MODEL != BLACK_HOLE
+// Adds pull of mass at (dx, dy) from the satelite, softened for close pairs
+static inline void addSatelitePull(double dx, double dy, double mass, double* ax, double* ay){
+   double distSquared = dx * dx + dy * dy + GRAVITY_SOFTENING * GRAVITY_SOFTENING;
+   double scale = mass * SATELITE_GRAVITY / (distSquared * sqrt(distSquared));
+   *ax += dx * scale;
+   *ay += dy * scale;
+}
+
+// Reference for the tree: pull of all other satelites summed in index order
+void directSumAcceleration(int i, double* ax, double* ay){
+   *ax = 0.0;
+   *ay = 0.0;
+   for(int j = 0; j < SATELITE_COUNT; ++j){
+      if(j != i){
+         addSatelitePull((double)satelites[j].position.x - satelites[i].position.x,
+            (double)satelites[j].position.y - satelites[i].position.y, 1.0, ax, ay);
+      }
+   }
+}
+#endif
+
+#if GRAVITY_MODEL == BARNES_HUT
+// Quadrant of the cell at level that the code falls into, y bit high and x bit low
+static inline int mortonDigit(unsigned int code, int level){
+   return (code >> (2 * (MORTON_LEVELS - 1 - level))) & 3;
+}
+
+// Spreads 16 bits to the even bits of the result
+static inline unsigned int spreadBits(unsigned int v){
+   v = (v | (v << 8)) & 0x00FF00FF;
+   v = (v | (v << 4)) & 0x0F0F0F0F;
+   v = (v | (v << 2)) & 0x33333333;
+   v = (v | (v << 1)) & 0x55555555;
+   return v;
+}
+
+// Sorts mortonOrder by mortonCode with a parallel LSD radix sort, 8 bits a pass.
+// Every thread counts and scatters its own static range, so the sort is stable.
+void sortMortonCodes(){
+   #pragma omp parallel
+   {
+      int threads = omp_get_num_threads();
+      int thread = omp_get_thread_num();
+      int begin = (long long)SATELITE_COUNT * thread / threads;
+      int end = (long long)SATELITE_COUNT * (thread + 1) / threads;
+      int* count = radixCount + 256 * thread;
+      for(int shift = 0; shift < 32; shift += 8){
+         for(int d = 0; d < 256; ++d){
+            count[d] = 0;
+         }
+         for(int k = begin; k < end; ++k){
+            ++count[(mortonCode[k] >> shift) & 0xFF];
+         }
+         #pragma omp barrier
+         #pragma omp single
+         {
+            // Offsets in digit order, threads in order inside a digit
+            int offset = 0;
+            for(int d = 0; d < 256; ++d){
+               for(int t = 0; t < threads; ++t){
+                  int c = radixCount[256 * t + d];
+                  radixCount[256 * t + d] = offset;
+                  offset += c;
+               }
+            }
+         }
+         for(int k = begin; k < end; ++k){
+            int slot = count[(mortonCode[k] >> shift) & 0xFF]++;
+            mortonScratch[slot] = mortonCode[k];
+            mortonOrderScratch[slot] = mortonOrder[k];
+         }
+         #pragma omp barrier
+         #pragma omp single
+         {
+            unsigned int* codes = mortonCode;
+            mortonCode = mortonScratch;
+            mortonScratch = codes;
+            int* order = mortonOrder;
+            mortonOrder = mortonOrderScratch;
+            mortonOrderScratch = order;
+         }
+      }
+   }
+}
+
+// Builds node of sorted satelites [first, first + count) whose codes share
+// the digits above level. Levels where all of them are in one quadrant are
+// skipped, so every inner node has at least two children and the tree has
+// at most 2 * SATELITE_COUNT nodes. Large subtrees are built as tasks.
+int buildTreeNode(int first, int count, int level){
+   while(count > BARNES_HUT_LEAF && level < MORTON_LEVELS &&
+      mortonDigit(mortonCode[first], level) == mortonDigit(mortonCode[first + count - 1], level)){
+      ++level;
+   }
+   int node;
+   #pragma omp atomic capture
+   node = treeNodes++;
+   treeNodeFirst[node] = first;
+   treeNodeCount[node] = count;
+   treeNodeLevel[node] = level;
+
+   double x = 0.0;
+   double y = 0.0;
+   if(count <= BARNES_HUT_LEAF || level == MORTON_LEVELS){
+      for(int k = first; k < first + count; ++k){
+         x += satelites[mortonOrder[k]].position.x;
+         y += satelites[mortonOrder[k]].position.y;
+      }
+   }
+   else{
+      int start = first;
+      for(int digit = 0; digit < 4; ++digit){
+         // First code of the range with a larger digit
+         int low = start;
+         int high = first + count;
+         while(low < high){
+            int middle = low + (high - low) / 2;
+            if(mortonDigit(mortonCode[middle], level) <= digit){
+               low = middle + 1;
+            }
+            else{
+               high = middle;
+            }
+         }
+         int* child = treeNodeChild + 4 * node + digit;
+         *child = -1;
+         if(low > start){
+            int childFirst = start;
+            int childCount = low - start;
+            #pragma omp task if(childCount > BARNES_HUT_TASK)
+            *child = buildTreeNode(childFirst, childCount, level + 1);
+         }
+         start = low;
+      }
+      #pragma omp taskwait
+      for(int digit = 0; digit < 4; ++digit){
+         int child = treeNodeChild[4 * node + digit];
+         if(child >= 0){
+            x += treeNodeX[child] * treeNodeCount[child];
+            y += treeNodeY[child] * treeNodeCount[child];
+         }
+      }
+   }
+   treeNodeX[node] = x / count;
+   treeNodeY[node] = y / count;
+   return node;
+}
+
+// Sorts satelites along a Morton curve of their bounding square and builds the quadtree
+void buildQuadtree(){
+   double left = INFINITY;
+   double right = -INFINITY;
+   double top = INFINITY;
+   double bottom = -INFINITY;
+   #pragma omp parallel for reduction(min:left, top) reduction(max:right, bottom)
+   for(int i = 0; i < SATELITE_COUNT; ++i){
+      left = fmin(left, satelites[i].position.x);
+      right = fmax(right, satelites[i].position.x);
+      top = fmin(top, satelites[i].position.y);
+      bottom = fmax(bottom, satelites[i].position.y);
+   }
+   treeLeft = left;
+   treeTop = top;
+   treeSize = fmax(fmax(right - left, bottom - top), 1.0) * (1.0 + 1e-6);
+
+   const double cells = 1 << MORTON_LEVELS;
+   #pragma omp parallel for
+   for(int i = 0; i < SATELITE_COUNT; ++i){
+      double cellX = (satelites[i].position.x - treeLeft) / treeSize * cells;
+      double cellY = (satelites[i].position.y - treeTop) / treeSize * cells;
+      unsigned int qx = cellX > 0.0 ? (unsigned int)fmin(cellX, cells - 1.0) : 0;
+      unsigned int qy = cellY > 0.0 ? (unsigned int)fmin(cellY, cells - 1.0) : 0;
+      mortonCode[i] = spreadBits(qx) | (spreadBits(qy) << 1);
+      mortonOrder[i] = i;
+   }
+   sortMortonCodes();
+
+   treeNodes = 0;
+   #pragma omp parallel
+   #pragma omp single
+   buildTreeNode(0, SATELITE_COUNT, 0);
+}
+
+// Pull of other satelites from the tree. Cells smaller than BARNES_HUT_THETA
+// times their distance pull from their center of mass, others are opened
+// and leaves are summed satelite by satelite.
+void barnesHutAcceleration(int i, double* ax, double* ay){
+   double x = satelites[i].position.x;
+   double y = satelites[i].position.y;
+   int stack[4 * (MORTON_LEVELS + 1)];
+   int size = 0;
+   stack[size++] = 0;
+   *ax = 0.0;
+   *ay = 0.0;
+   while(size > 0){
+      int node = stack[--size];
+      int count = treeNodeCount[node];
+      if(count <= BARNES_HUT_LEAF || treeNodeLevel[node] == MORTON_LEVELS){
+         for(int k = treeNodeFirst[node]; k < treeNodeFirst[node] + count; ++k){
+            int j = mortonOrder[k];
+            if(j != i){
+               addSatelitePull(satelites[j].position.x - x, satelites[j].position.y - y, 1.0, ax, ay);
+            }
+         }
+         continue;
+      }
+      double dx = treeNodeX[node] - x;
+      double dy = treeNodeY[node] - y;
+      double cellSize = ldexp(treeSize, -treeNodeLevel[node]);
+      if(cellSize * cellSize < BARNES_HUT_THETA * BARNES_HUT_THETA * (dx * dx + dy * dy)){
+         addSatelitePull(dx, dy, count, ax, ay);
+         continue;
+      }
+      for(int digit = 0; digit < 4; ++digit){
+         int child = treeNodeChild[4 * node + digit];
+         if(child >= 0){
+            stack[size++] = child;
+         }
+      }
+   }
+}
+
+// Compares tree to direct summation on at most 1000 satelites and prints
+// largest and root mean square error relative to the direct pull
+void checkBarnesHutForces(){
+   int step = SATELITE_COUNT > 1000 ? SATELITE_COUNT / 1000 : 1;
+   double largest = 0.0;
+   double squares = 0.0;
+   int samples = 0;
+   #pragma omp parallel for reduction(max:largest) reduction(+:squares, samples)
+   for(int i = 0; i < SATELITE_COUNT; i += step){
+      double treeX, treeY, directX, directY;
+      barnesHutAcceleration(i, &treeX, &treeY);
+      directSumAcceleration(i, &directX, &directY);
+      double error = hypot(treeX - directX, treeY - directY) / hypot(directX, directY);
+      largest = fmax(largest, error);
+      squares += error * error;
+      ++samples;
+   }
+   printf("Barnes-Hut force error: largest %.3e, rms %.3e over %i satelites\n",
+      largest, sqrt(squares / samples), samples);
+}
+#endif
+
+#if GRAVITY_MODEL != BLACK_HOLE
+// Black hole and satelites pull each other. Forces are evaluated
+// GRAVITY_BATCHES times a frame and the substeps between them are done as
+// in the reference with the force of the batch.
+void mutualGravityEngine(int deltaTime, int updates){
+   for(int batch = 0; batch < GRAVITY_BATCHES; ++batch){
+#if GRAVITY_MODEL == BARNES_HUT
+      buildQuadtree();
+      if(batch == 0 && frameNumber < 2){
+         checkBarnesHutForces();
+      }
+#endif
+      #pragma omp parallel for schedule(dynamic, 64)
+      for(int i = 0; i < SATELITE_COUNT; ++i){
+         double ax, ay;
+#if GRAVITY_MODEL == BARNES_HUT
+         barnesHutAcceleration(i, &ax, &ay);
+#else
+         directSumAcceleration(i, &ax, &ay);
+#endif
+         double dx = satelites[i].position.x - HORIZONTAL_CENTER;
+         double dy = satelites[i].position.y - VERTICAL_CENTER;
+         double distSquared = dx * dx + dy * dy;
+         double scale = GRAVITY / (distSquared * sqrt(distSquared));
+         accelerationX[i] = ax - dx * scale;
+         accelerationY[i] = ay - dy * scale;
+      }
+
+      const int first = batch * updates / GRAVITY_BATCHES;
+      const int last = (batch + 1) * updates / GRAVITY_BATCHES;
+      #pragma omp parallel for
+      for(int i = 0; i < SATELITE_COUNT; ++i){
+         float ax = accelerationX[i];
+         float ay = accelerationY[i];
+         for(int physicsUpdateIndex = first; physicsUpdateIndex < last; ++physicsUpdateIndex){
+            satelites[i].velocity.x += ax * deltaTime / updates;
+            satelites[i].velocity.y += ay * deltaTime / updates;
+            satelites[i].position.x = satelites[i].position.x + satelites[i].velocity.x * deltaTime / updates;
+            satelites[i].position.y = satelites[i].position.y + satelites[i].velocity.y * deltaTime / updates;
+         }
+      }
+   }
+}
+#endif
+
+#if GRAVITY_FIELD
+// Sums pull of all attractors to every grid point of the field. Called at
+// init, and again whenever attractors move or another potential is wanted
+void buildGravityField(){
+   #pragma omp parallel for schedule(static)
+   for(int row = 0; row < FIELD_ROWS; ++row){
+      double y = row * FIELD_CELL - FIELD_MARGIN;
+      for(int column = 0; column < FIELD_COLUMNS; ++column){
+         double x = column * FIELD_CELL - FIELD_MARGIN;
+         double ax = 0.0;
+         double ay = 0.0;
+         for(int a = 0; a < ATTRACTOR_COUNT; ++a){
+            double dx = attractors[a].x - x;
+            double dy = attractors[a].y - y;
+            double distSquared = dx * dx + dy * dy + FIELD_SOFTENING * FIELD_SOFTENING;
+            double scale = attractors[a].gravity / (distSquared * sqrt(distSquared));
+            ax += dx * scale;
+            ay += dy * scale;
+         }
+         fieldX[row * FIELD_COLUMNS + column] = ax;
+         fieldY[row * FIELD_COLUMNS + column] = ay;
+      }
+   }
+}
+
+// Bilinear sample of the field, positions outside it get the edge value.
+// Without trapping math the clamps can be done with vector selects.
+__attribute__((optimize("no-trapping-math")))
+static inline vector sampleGravityField(float x, float y){
+   float u = (x + FIELD_MARGIN) / FIELD_CELL;
+   float v = (y + FIELD_MARGIN) / FIELD_CELL;
+   u = u > 0.0f ? u : 0.0f;
+   u = u < FIELD_COLUMNS - 1 ? u : FIELD_COLUMNS - 1;
+   v = v > 0.0f ? v : 0.0f;
+   v = v < FIELD_ROWS - 1 ? v : FIELD_ROWS - 1;
+   int column = (int)u < FIELD_COLUMNS - 1 ? (int)u : FIELD_COLUMNS - 2;
+   int row = (int)v < FIELD_ROWS - 1 ? (int)v : FIELD_ROWS - 2;
+   float fu = u - column;
+   float fv = v - row;
+   int i = row * FIELD_COLUMNS + column;
+   vector acceleration;
+   float top = fieldX[i] + fu * (fieldX[i + 1] - fieldX[i]);
+   float bottom = fieldX[i + FIELD_COLUMNS] + fu * (fieldX[i + FIELD_COLUMNS + 1] - fieldX[i + FIELD_COLUMNS]);
+   acceleration.x = top + fv * (bottom - top);
+   top = fieldY[i] + fu * (fieldY[i + 1] - fieldY[i]);
+   bottom = fieldY[i + FIELD_COLUMNS] + fu * (fieldY[i + FIELD_COLUMNS + 1] - fieldY[i + FIELD_COLUMNS]);
+   acceleration.y = top + fv * (bottom - top);
+   return acceleration;
+}
+
+// Field is sampled at every substep, so the pull follows the satelite during
+// the frame. Substeps are the outer loop of a block of satelites, which
+// are kept in local arrays and the inner loop over them is vectorized.
+// State is kept in double: in float a substep moves less than the spacing
+// of floats near the window center and rounding would dominate the error.
+__attribute__((optimize("no-trapping-math")))
+void gravityFieldEngine(int deltaTime, int updates){
+   #pragma omp parallel for schedule(static)
+   for(int block = 0; block < SATELITE_COUNT; block += FIELD_BLOCK){
+      int count = SATELITE_COUNT - block < FIELD_BLOCK ? SATELITE_COUNT - block : FIELD_BLOCK;
+      double x[FIELD_BLOCK];
+      double y[FIELD_BLOCK];
+      double vx[FIELD_BLOCK];
+      double vy[FIELD_BLOCK];
+      for(int k = 0; k < count; ++k){
+         x[k] = satelites[block + k].position.x;
+         y[k] = satelites[block + k].position.y;
+         vx[k] = satelites[block + k].velocity.x;
+         vy[k] = satelites[block + k].velocity.y;
+      }
+      for(int physicsUpdateIndex = 0; physicsUpdateIndex < updates; ++physicsUpdateIndex){
+         #pragma omp simd
+         for(int k = 0; k < count; ++k){
+            vector acceleration = sampleGravityField(x[k], y[k]);
+            vx[k] += acceleration.x * deltaTime / updates;
+            vy[k] += acceleration.y * deltaTime / updates;
+            x[k] = x[k] + vx[k] * deltaTime / updates;
+            y[k] = y[k] + vy[k] * deltaTime / updates;
+         }
+      }
+      for(int k = 0; k < count; ++k){
+         satelites[block + k].position.x = x[k];
+         satelites[block + k].position.y = y[k];
+         satelites[block + k].velocity.x = vx[k];
+         satelites[block + k].velocity.y = vy[k];
+      }
+   }
+}
+#endif
+
+// ## You are asked to make this code parallel ##
+// Physics engine loop. (This is called once a frame before graphics engine) 
+// Moves the satelites based on gravity
+// This is done multiple times in a frame because the Euler integration 
+// is not accurate enough to be done only once
+void parallelPhysicsEngine(int deltaTime){
+   // Fixed step makes runs with the same seed identical
+   if(fixedDeltaTime > 0){
+      deltaTime = fixedDeltaTime;
+   }
+#if INTEGRATOR == EULER_REFERENCE
+	const int physicsUpdatesInOneFrame = 10000;
+#endif
+#if SIMD_PHYSICS
+   simdPhysicsEngine(deltaTime, physicsUpdatesInOneFrame);
+#elif PARAREAL_PHYSICS
+   pararealPhysicsEngine(deltaTime, physicsUpdatesInOneFrame);
+#elif GRAVITY_MODEL != BLACK_HOLE
+   mutualGravityEngine(deltaTime, physicsUpdatesInOneFrame);
+#elif GRAVITY_FIELD
+   gravityFieldEngine(deltaTime, physicsUpdatesInOneFrame);
+#else
+	#pragma omp parallel for
+   for(int i = 0; i < SATELITE_COUNT; ++i){
+#if INTEGRATOR != EULER_REFERENCE
+      integrateSatelite(i, deltaTime);
+#else
+      // Distance to the blackhole (bit ugly code because C-struct cannot have member functions)
+      vector positionToBlackHole = {.x = satelites[i].position.x -
+         HORIZONTAL_CENTER, .y = satelites[i].position.y - VERTICAL_CENTER};
+      float distToBlackHoleSquared = 
+         positionToBlackHole.x * positionToBlackHole.x +
+         positionToBlackHole.y * positionToBlackHole.y;
+      float distToBlackHole = sqrt(distToBlackHoleSquared);
+
+      // Gravity force
+      vector normalizedDirection = { 
+         .x = positionToBlackHole.x / distToBlackHole,
+         .y = positionToBlackHole.y / distToBlackHole};
+      float accumulation = GRAVITY / distToBlackHoleSquared;
+
+      // Delta time is used to make velocity same despite different FPS
+      // Update velocity based on force
+      
+      for(int physicsUpdateIndex = 0; physicsUpdateIndex < physicsUpdatesInOneFrame; ++physicsUpdateIndex){
+	      satelites[i].velocity.x -= accumulation * normalizedDirection.x * deltaTime / physicsUpdatesInOneFrame;
+	      satelites[i].velocity.y -= accumulation * normalizedDirection.y * deltaTime / physicsUpdatesInOneFrame;
+
+	      // Update position based on velocity
+	      satelites[i].position.x = satelites[i].position.x + satelites[i].velocity.x * deltaTime / physicsUpdatesInOneFrame;
+	      satelites[i].position.y = satelites[i].position.y + satelites[i].velocity.y * deltaTime / physicsUpdatesInOneFrame;
+      }
+#endif
+   }
+#endif
+}
+
+// Color of one pixel by checking all satelites, same as in sequential engine
+color bruteForcePixel(int i){
+
+   // Row wise ordering
+   vector pixel = {.x = i % WINDOW_WIDTH, .y = i / WINDOW_WIDTH};
+
+   // This color is used for coloring the pixel
+   color renderColor = {.red = 0.f, .green = 0.f, .blue = 0.f};
+
+   // Find closest satelite
+   float shortestDistance = INFINITY;
+
+   for(int j = 0; j < SATELITE_COUNT; ++j){
+      vector difference = {.x = pixel.x - satelites[j].position.x,
+                           .y = pixel.y - satelites[j].position.y};
+      float distance = sqrt(difference.x * difference.x + 
+        difference.y * difference.y);
+      if(distance < shortestDistance){
+         shortestDistance = distance;
+         renderColor = satelites[j].identifier;
+      }
+      // Display satelites themselves with white
+      if(distance < SATELITE_RADIUS){
+         renderColor.red = 1.0f;
+         renderColor.green = 1.0f;
+         renderColor.blue = 1.0f;
+      }
+   }
+   return renderColor;
+}
+
+#if RENDER_ENGINE == BRUTE_FORCE
+// Owner pass of one row: satelites are the outer loop so that the inner loop
+// over pixels is a branch-free min-reduction the compiler can vectorize.
+// Strict comparison in index order keeps the first satelite on ties.
+// Distances are sums of squares, so sqrt never sets errno and the Makefile
+// passes -fno-math-errno; without it gcc keeps the libm call and the loop
+// stays scalar (an optimize attribute on the function does not reach sqrtf).
+void closestSatelitesOfRow(int y, float* shortestDistance, int* closest){
+   for(int x = 0; x < WINDOW_WIDTH; ++x){
+      shortestDistance[x] = INFINITY;
+      closest[x] = 0;
+   }
+   for(int j = 0; j < SATELITE_COUNT; ++j){
+      float sateliteX = satelites[j].position.x;
+      float differenceY = y - satelites[j].position.y;
+      for(int x = 0; x < WINDOW_WIDTH; ++x){
+         float differenceX = (float)x - sateliteX;
+         float distance = sqrtf(differenceX * differenceX + differenceY * differenceY);
+         float shortest = shortestDistance[x];
+         int owner = closest[x];
+         if(distance < shortest){
+            shortest = distance;
+            owner = j;
+         }
+         shortestDistance[x] = shortest;
+         closest[x] = owner;
+      }
+   }
+}
+
+// Disk pass: a pixel is white if any satelite is closer than the radius,
+// so disks can be stamped over their bounding boxes in any order
+void stampSateliteDisks(){
+   const color white = {.red = 1.0f, .green = 1.0f, .blue = 1.0f};
+   for(int j = 0; j < SATELITE_COUNT; ++j){
+      float left = floorf(satelites[j].position.x - SATELITE_RADIUS);
+      float top = floorf(satelites[j].position.y - SATELITE_RADIUS);
+      if(!(left > -2.0f * SATELITE_RADIUS - 2.0f && left < WINDOW_WIDTH &&
+         top > -2.0f * SATELITE_RADIUS - 2.0f && top < WINDOW_HEIGHT)){
+         continue;
+      }
+      // Pixels with |x - satelite.x| < radius are left ... left + 2 * radius + 1
+      for(int y = (int)top; y <= (int)top + (int)(2.0f * SATELITE_RADIUS) + 1; ++y){
+         for(int x = (int)left; x <= (int)left + (int)(2.0f * SATELITE_RADIUS) + 1; ++x){
+            if(x < 0 || x >= WINDOW_WIDTH || y < 0 || y >= WINDOW_HEIGHT){
+               continue;
+            }
+            vector pixel = {.x = x, .y = y};
+            vector difference = {.x = pixel.x - satelites[j].position.x,
+                                 .y = pixel.y - satelites[j].position.y};
+            float distance = sqrt(difference.x * difference.x +
+               difference.y * difference.y);
+            if(distance < SATELITE_RADIUS){
+               pixels[y * WINDOW_WIDTH + x] = white;
+            }
+         }
+      }
+   }
+}
+#endif
+
+#if RENDER_ENGINE == DISTANCE_TRANSFORM || RENDER_ENGINE == SCANLINE_SPANS
+// Column bucket of a satelite, satelites outside the window go to the edge buckets
+int sateliteColumn(int j){
+   float x = satelites[j].position.x;
+   if(!(x >= 0.0f)){
+      return 0;
+   }
+   if(x >= WINDOW_WIDTH){
+      return WINDOW_WIDTH + 1;
+   }
+   return (int)x + 1;
+}
+
+// Column pass: counting sort of satelites into column buckets and
+// insertion sort inside each bucket gives satelites ordered by x in O(W + S)
+void sortSatelitesByColumn(){
+   for(int c = 0; c < WINDOW_WIDTH + 3; ++c){
+      columnStart[c] = 0;
+   }
+   for(int j = 0; j < SATELITE_COUNT; ++j){
+      columnStart[sateliteColumn(j) + 1]++;
+   }
+   for(int c = 1; c < WINDOW_WIDTH + 3; ++c){
+      columnStart[c] += columnStart[c - 1];
+   }
+   for(int j = 0; j < SATELITE_COUNT; ++j){
+      sortedSatelites[columnStart[sateliteColumn(j)]++] = j;
+   }
+
+   // Scatter kept index order, now columnStart[c] is end of bucket c
+   for(int c = 0; c < WINDOW_WIDTH + 2; ++c){
+      int start = c == 0 ? 0 : columnStart[c - 1];
+      for(int k = start + 1; k < columnStart[c]; ++k){
+         int j = sortedSatelites[k];
+         int m = k;
+         while(m > start && satelites[sortedSatelites[m - 1]].position.x > satelites[j].position.x){
+            sortedSatelites[m] = sortedSatelites[m - 1];
+            --m;
+         }
+         sortedSatelites[m] = j;
+      }
+   }
+   for(int q = 0; q < SATELITE_COUNT; ++q){
+      sortedPosition[sortedSatelites[q]] = q;
+   }
+}
+
+// Pixels closer to a span boundary than this can have their owner changed by
+// float rounding. Difference of squared distances to the two owners grows
+// linearly away from the boundary, 2 * |vertex difference| per pixel.
+double spanMargin(double z, double vertexA, double heightA, double vertexB){
+   double tolerance = 1.0 + 1e-5 * (heightA + (z - vertexA) * (z - vertexA));
+   return tolerance / (2.0 * fabs(vertexB - vertexA)) + 1.0;
+}
+
+// Row pass: lower envelope of parabolas (x - satelite.x)^2 + (y - satelite.y)^2
+// (Felzenszwalb & Huttenlocher) built from satelites in x-order. Segment k is
+// owned by owner[k] and covers boundary[k] < x <= boundary[k + 1]. A parabola
+// which only touches the envelope is kept as a zero width segment, its
+// satelite can still win the pixel there by first index tie break.
+// Returns index of the last segment.
+int buildRowEnvelope(int y, int* owner, double* vertex, double* height, double* boundary){
+   int k = -1;
+   for(int q = 0; q < SATELITE_COUNT; ++q){
+      int j = sortedSatelites[q];
+      double x = satelites[j].position.x;
+      double dy = y - satelites[j].position.y;
+      double h = dy * dy;
+      double s = -INFINITY;
+      int dominated = 0;
+
+      while(k >= 0){
+         if(x == vertex[k]){
+            // Same vertex, only lower parabola matters
+            if(h >= height[k]){
+               dominated = 1;
+               break;
+            }
+            --k;
+            continue;
+         }
+         s = ((h + x * x) - (height[k] + vertex[k] * vertex[k])) /
+            (2.0 * x - 2.0 * vertex[k]);
+         if(s >= boundary[k]){
+            break;
+         }
+         --k;
+      }
+      if(dominated){
+         continue;
+      }
+
+      ++k;
+      owner[k] = j;
+      vertex[k] = x;
+      height[k] = h;
+      boundary[k] = k == 0 ? -INFINITY : s;
+   }
+   boundary[k + 1] = INFINITY;
+   return k;
+}
+
+// Owners of the segment and of all neighbouring segments whose boundary is
+// within rounding margin of the pixel are compared exactly like in the
+// sequential engine, so that float rounding and first index tie break give
+// identical results also when several satelites are equally far.
+int closestOnEnvelope(int x, int y, const int* owner, const double* vertex, const double* height,
+   const double* boundary, int k, int segment, float* shortestDistance){
+   int first = segment;
+   while(first > 0 && x - boundary[first] <=
+      spanMargin(boundary[first], vertex[first], height[first], vertex[first - 1])){
+      --first;
+   }
+   int last = segment;
+   while(last < k && boundary[last + 1] - x <=
+      spanMargin(boundary[last + 1], vertex[last], height[last], vertex[last + 1])){
+      ++last;
+   }
+
+   vector pixel = {.x = x, .y = y};
+   int closest = -1;
+   *shortestDistance = INFINITY;
+   for(int c = first; c <= last; ++c){
+      // Satelites at the same x as the owner were left out by its lower
+      // parabola, but rounding can make them equally far with lower index
+      int q = sortedPosition[owner[c]];
+      float column = satelites[owner[c]].position.x;
+      while(q > 0 && satelites[sortedSatelites[q - 1]].position.x == column){
+         --q;
+      }
+      for(; q < SATELITE_COUNT && satelites[sortedSatelites[q]].position.x == column; ++q){
+         int j = sortedSatelites[q];
+         vector difference = {.x = pixel.x - satelites[j].position.x,
+                              .y = pixel.y - satelites[j].position.y};
+         float distance = sqrt(difference.x * difference.x +
+            difference.y * difference.y);
+         if(distance < *shortestDistance ||
+            (distance == *shortestDistance && j < closest)){
+            *shortestDistance = distance;
+            closest = j;
+         }
+      }
+   }
+   return closest;
+}
+
+// First pixel at or after x, clamped to the row
+int spanPixel(double x){
+   if(x <= 0.0){
+      return 0;
+   }
+   if(x >= WINDOW_WIDTH){
+      return WINDOW_WIDTH;
+   }
+   return (int)ceil(x);
+}
+
+// Pixels [start, end) of the row belong to the segment. Pixels [fillStart, fillEnd)
+// are farther than rounding margin from both boundaries, so its owner is closest
+// there without comparing, unless another satelite has the same x as the owner.
+void segmentPixels(int segment, int k, const int* owner, const double* vertex, const double* height,
+   const double* boundary, int* start, int* fillStart, int* fillEnd, int* end){
+   // Segment owns pixels boundary[segment] < x <= boundary[segment + 1]
+   *start = spanPixel(nextafter(boundary[segment], INFINITY));
+   *end = spanPixel(nextafter(boundary[segment + 1], INFINITY));
+   if(*end < *start){
+      *end = *start;
+   }
+
+   *fillStart = *start;
+   *fillEnd = *end;
+   if(segment > 0){
+      *fillStart = spanPixel(boundary[segment] + spanMargin(boundary[segment],
+         vertex[segment], height[segment], vertex[segment - 1]));
+   }
+   if(segment < k){
+      *fillEnd = spanPixel(boundary[segment + 1] - spanMargin(boundary[segment + 1],
+         vertex[segment], height[segment], vertex[segment + 1]));
+   }
+   *fillStart = *fillStart < *start ? *start : (*fillStart > *end ? *end : *fillStart);
+   *fillEnd = *fillEnd > *end ? *end : (*fillEnd < *fillStart ? *fillStart : *fillEnd);
+
+   // Satelites at the same x as the owner can tie anywhere on the segment
+   int q = sortedPosition[owner[segment]];
+   float column = satelites[owner[segment]].position.x;
+   if((q > 0 && satelites[sortedSatelites[q - 1]].position.x == column) ||
+      (q < SATELITE_COUNT - 1 && satelites[sortedSatelites[q + 1]].position.x == column)){
+      *fillEnd = *fillStart;
+   }
+}
+#endif
+
+#if RENDER_ENGINE == DISTANCE_TRANSFORM
+// Every pixel of the row reads its segment from the envelope
+void distanceTransformGraphicsEngine(){
+   sortSatelitesByColumn();
+
+   #pragma omp parallel
+   {
+      int thread = omp_get_thread_num();
+      int* owner = envelopeOwner + thread * SATELITE_COUNT;
+      double* vertex = envelopeVertex + thread * SATELITE_COUNT;
+      double* height = envelopeHeight + thread * SATELITE_COUNT;
+      double* boundary = envelopeBoundary + thread * (SATELITE_COUNT + 1);
+
+      #pragma omp for schedule(static)
+      for(int y = 0; y < WINDOW_HEIGHT; ++y){
+         int k = buildRowEnvelope(y, owner, vertex, height, boundary);
+
+         int segment = 0;
+         int start, fillStart, fillEnd, end;
+         segmentPixels(segment, k, owner, vertex, height, boundary, &start, &fillStart, &fillEnd, &end);
+         for(int x = 0; x < WINDOW_WIDTH; ++x){
+            while(end <= x){
+               ++segment;
+               segmentPixels(segment, k, owner, vertex, height, boundary, &start, &fillStart, &fillEnd, &end);
+            }
+
+            // Owner of the segment is compared to others only near its boundaries
+            float shortestDistance;
+            int closest;
+            if(x >= fillStart && x < fillEnd){
+               closest = owner[segment];
+               vector difference = {.x = x - satelites[closest].position.x,
+                                    .y = y - satelites[closest].position.y};
+               shortestDistance = sqrt(difference.x * difference.x +
+                  difference.y * difference.y);
+            }
+            else{
+               closest = closestOnEnvelope(x, y, owner, vertex, height, boundary, k, segment, &shortestDistance);
+            }
+
+            // Display satelites themselves with white, closest one is inside radius if any is
+            color renderColor = satelites[closest].identifier;
+            if(shortestDistance < SATELITE_RADIUS){
+               renderColor.red = 1.0f;
+               renderColor.green = 1.0f;
+               renderColor.blue = 1.0f;
+            }
+            pixels[y * WINDOW_WIDTH + x] = renderColor;
+         }
+      }
+   }
+}
+#endif
+
+#if RENDER_ENGINE == SCANLINE_SPANS
+// Resolves pixels [from, to) of a segment one by one with the exact comparison
+void resolveSpanPixels(int y, int from, int to, const int* owner, const double* vertex,
+   const double* height, const double* boundary, int k, int segment){
+   for(int x = from; x < to; ++x){
+      float shortestDistance;
+      int closest = closestOnEnvelope(x, y, owner, vertex, height, boundary, k, segment, &shortestDistance);
+      pixels[y * WINDOW_WIDTH + x] = satelites[closest].identifier;
+   }
+}
+
+// Rows are split to spans (x_start, x_end, owner) by the envelope. Span
+// interiors are filled with the owner color, pixels near span ends are
+// resolved exactly and satelite disks are stamped last.
+void scanlineGraphicsEngine(){
+   sortSatelitesByColumn();
+
+   #pragma omp parallel
+   {
+      int thread = omp_get_thread_num();
+      int* owner = envelopeOwner + thread * SATELITE_COUNT;
+      double* vertex = envelopeVertex + thread * SATELITE_COUNT;
+      double* height = envelopeHeight + thread * SATELITE_COUNT;
+      double* boundary = envelopeBoundary + thread * (SATELITE_COUNT + 1);
+
+      #pragma omp for schedule(static)
+      for(int y = 0; y < WINDOW_HEIGHT; ++y){
+         int k = buildRowEnvelope(y, owner, vertex, height, boundary);
+         color* row = pixels + y * WINDOW_WIDTH;
+
+         for(int segment = 0; segment <= k; ++segment){
+            int start, fillStart, fillEnd, end;
+            segmentPixels(segment, k, owner, vertex, height, boundary, &start, &fillStart, &fillEnd, &end);
+            if(start >= end){
+               continue;
+            }
+
+            resolveSpanPixels(y, start, fillStart, owner, vertex, height, boundary, k, segment);
+            color spanColor = satelites[owner[segment]].identifier;
+            for(int x = fillStart; x < fillEnd; ++x){
+               row[x] = spanColor;
+            }
+            resolveSpanPixels(y, fillEnd, end, owner, vertex, height, boundary, k, segment);
+         }
+
+         // Stamp disks of satelites near this row, same test as in sequential engine
+         const color white = {.red = 1.0f, .green = 1.0f, .blue = 1.0f};
+         for(int j = 0; j < SATELITE_COUNT; ++j){
+            float dy = y - satelites[j].position.y;
+            if(fabsf(dy) >= SATELITE_RADIUS + 1.0f){
+               continue;
+            }
+            int from = spanPixel(satelites[j].position.x - SATELITE_RADIUS - 1.0f);
+            int to = spanPixel(satelites[j].position.x + SATELITE_RADIUS + 1.0f);
+            for(int x = from; x < to; ++x){
+               vector pixel = {.x = x, .y = y};
+               vector difference = {.x = pixel.x - satelites[j].position.x,
+                                    .y = pixel.y - satelites[j].position.y};
+               float distance = sqrt(difference.x * difference.x +
+                  difference.y * difference.y);
+               if(distance < SATELITE_RADIUS){
+                  row[x] = white;
+               }
+            }
+         }
+      }
+   }
+}
+#endif
+
+#if RENDER_ENGINE == BLOCK_FILL
+// Closest and second closest squared distance of a point, corner test needs
+// the gap between them to know that float rounding cannot change the owner
+int closestTwoSatelites(double x, double y, double* first, double* second){
+   int closest = -1;
+   *first = INFINITY;
+   *second = INFINITY;
+   for(int j = 0; j < SATELITE_COUNT; ++j){
+      double dx = x - satelites[j].position.x;
+      double dy = y - satelites[j].position.y;
+      double distanceSquared = dx * dx + dy * dy;
+      if(distanceSquared < *first){
+         *second = *first;
+         *first = distanceSquared;
+         closest = j;
+      }
+      else if(distanceSquared < *second){
+         *second = distanceSquared;
+      }
+   }
+   return closest;
+}
+
+// Returns the satelite owning every pixel of the block or -1 if that cannot be proven.
+// Difference of squared distances to two satelites is linear in pixel position,
+// so a safe gap at all four corners holds inside the whole block (cells are convex).
+int blockOwner(int x0, int y0, int x1, int y1){
+   int corners[4][2] = {{x0, y0}, {x1, y0}, {x0, y1}, {x1, y1}};
+   int owner = -1;
+   for(int c = 0; c < 4; ++c){
+      double first, second;
+      int closest = closestTwoSatelites(corners[c][0], corners[c][1], &first, &second);
+      if(closest < 0 || (owner >= 0 && closest != owner) ||
+         second - first <= 1.0 + 1e-5 * second){
+         return -1;
+      }
+      owner = closest;
+   }
+
+   // Disk of the owner is the only one which can reach pixels of its cell
+   double dx = fmax(fmax(x0 - satelites[owner].position.x, 0.0),
+      satelites[owner].position.x - x1);
+   double dy = fmax(fmax(y0 - satelites[owner].position.y, 0.0),
+      satelites[owner].position.y - y1);
+   double diskReach = SATELITE_RADIUS + 0.01;
+   if(dx * dx + dy * dy < diskReach * diskReach){
+      return -1;
+   }
+   return owner;
+}
+
+// Fills uniform blocks at once and subdivides blocks straddling a cell boundary
+void renderBlock(int x0, int y0, int size){
+   int x1 = x0 + size - 1 < WINDOW_WIDTH ? x0 + size - 1 : WINDOW_WIDTH - 1;
+   int y1 = y0 + size - 1 < WINDOW_HEIGHT ? y0 + size - 1 : WINDOW_HEIGHT - 1;
+
+   int owner = blockOwner(x0, y0, x1, y1);
+   if(owner >= 0){
+      color renderColor = satelites[owner].identifier;
+      for(int y = y0; y <= y1; ++y){
+         for(int x = x0; x <= x1; ++x){
+            pixels[y * WINDOW_WIDTH + x] = renderColor;
+         }
+      }
+   }
+   else if(size <= MIN_BLOCK_SIZE){
+      for(int y = y0; y <= y1; ++y){
+         for(int x = x0; x <= x1; ++x){
+            pixels[y * WINDOW_WIDTH + x] = bruteForcePixel(y * WINDOW_WIDTH + x);
+         }
+      }
+   }
+   else{
+      int half = size / 2;
+      renderBlock(x0, y0, half);
+      if(x0 + half <= x1){
+         renderBlock(x0 + half, y0, half);
+      }
+      if(y0 + half <= y1){
+         renderBlock(x0, y0 + half, half);
+         if(x0 + half <= x1){
+            renderBlock(x0 + half, y0 + half, half);
+         }
+      }
+   }
+}
+
+void blockFillGraphicsEngine(){
+   const int blocksInRow = (WINDOW_WIDTH + BLOCK_SIZE - 1) / BLOCK_SIZE;
+   const int blocksInColumn = (WINDOW_HEIGHT + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+   // Boundary blocks are much slower than interior ones
+   #pragma omp parallel for schedule(dynamic)
+   for(int b = 0; b < blocksInRow * blocksInColumn; ++b){
+      renderBlock(b % blocksInRow * BLOCK_SIZE, b / blocksInRow * BLOCK_SIZE, BLOCK_SIZE);
+   }
+}
+#endif
+
+#if RENDER_ENGINE == UNIFORM_GRID
+// Grid cell of a satelite, satelites outside the window go to the edge cells
+int sateliteCell(int j){
+   int column = (int)floor(satelites[j].position.x / gridCellSize);
+   int row = (int)floor(satelites[j].position.y / gridCellSize);
+   column = column < 0 ? 0 : (column >= gridColumns ? gridColumns - 1 : column);
+   row = row < 0 ? 0 : (row >= gridRows ? gridRows - 1 : row);
+   return row * gridColumns + column;
+}
+
+// Counting sort of satelites to grid cells, O(S + cells)
+void buildGrid(){
+   int cells = gridColumns * gridRows;
+   int blocks = gridBlockColumns * gridBlockRows;
+   for(int c = 0; c <= cells; ++c){
+      gridCellStart[c] = 0;
+   }
+   for(int b = 0; b < blocks; ++b){
+      gridBlockCount[b] = 0;
+   }
+   for(int j = 0; j < SATELITE_COUNT; ++j){
+      int cell = sateliteCell(j);
+      gridCellStart[cell + 1]++;
+      gridBlockCount[cell / gridColumns / GRID_BLOCK * gridBlockColumns +
+         cell % gridColumns / GRID_BLOCK]++;
+   }
+   for(int c = 0; c < cells; ++c){
+      gridCellStart[c + 1] += gridCellStart[c];
+   }
+   for(int j = 0; j < SATELITE_COUNT; ++j){
+      gridSatelites[gridCellStart[sateliteCell(j)]++] = j;
+   }
+
+   // Scatter moved starts to the ends of the cells, shift them back
+   for(int c = cells; c > 0; --c){
+      gridCellStart[c] = gridCellStart[c - 1];
+   }
+   gridCellStart[0] = 0;
+}
+
+// Tells if any satelite of a square area can be closer than the given distance,
+// also holds for satelites clamped to edge cells because they are further out
+static inline int areaInReach(vector pixel, int left, int top, int size, float reach){
+   float dx = pixel.x < left ? left - pixel.x :
+      (pixel.x > left + size ? pixel.x - (left + size) : 0.0f);
+   float dy = pixel.y < top ? top - pixel.y :
+      (pixel.y > top + size ? pixel.y - (top + size) : 0.0f);
+   return dx * dx + dy * dy <= reach * reach;
+}
+
+// Compares satelites of one cell to the closest one so far.
+// sqrtf gives the same float as sqrt of the float sum in sequential engine.
+static inline void searchCell(int cell, vector pixel, float* shortestDistance, int* closest){
+   for(int m = gridCellStart[cell]; m < gridCellStart[cell + 1]; ++m){
+      int j = gridSatelites[m];
+      vector difference = {.x = pixel.x - satelites[j].position.x,
+                           .y = pixel.y - satelites[j].position.y};
+      float distance = sqrtf(difference.x * difference.x +
+         difference.y * difference.y);
+      if(distance < *shortestDistance ||
+         (distance == *shortestDistance && j < *closest)){
+         *shortestDistance = distance;
+         *closest = j;
+      }
+   }
+}
+
+// Checks satelites of the cells on one side of a ring, from and to are
+// inclusive cell coordinates along the side. Empty coarse blocks and
+// blocks or cells further than the closest satelite found are skipped.
+void searchRingSide(int fixed, int from, int to, int horizontal,
+   vector pixel, float* shortestDistance, int* closest){
+   int limit = horizontal ? gridColumns : gridRows;
+   if(fixed < 0 || fixed >= (horizontal ? gridRows : gridColumns)){
+      return;
+   }
+   from = from < 0 ? 0 : from;
+   to = to >= limit ? limit - 1 : to;
+
+   const int blockSize = GRID_BLOCK * gridCellSize;
+   for(int k = from; k <= to; ++k){
+      int row = horizontal ? fixed : k;
+      int column = horizontal ? k : fixed;
+      int blockRow = row / GRID_BLOCK;
+      int blockColumn = column / GRID_BLOCK;
+      if(gridBlockCount[blockRow * gridBlockColumns + blockColumn] == 0 ||
+         !areaInReach(pixel, blockColumn * blockSize, blockRow * blockSize, blockSize,
+            *shortestDistance + 0.01f)){
+         k = (k / GRID_BLOCK + 1) * GRID_BLOCK - 1;
+         continue;
+      }
+      int cell = row * gridColumns + column;
+      if(gridCellStart[cell] == gridCellStart[cell + 1] ||
+         !areaInReach(pixel, column * gridCellSize, row * gridCellSize, gridCellSize,
+            *shortestDistance + 0.01f)){
+         continue;
+      }
+      searchCell(cell, pixel, shortestDistance, closest);
+   }
+}
+
+// Checks all cells which can hold a satelite closer than the closest one so
+// far. Reach box shrinks while closer satelites are found. Truncation is used
+// instead of floor, negative start indices are clamped to zero anyway.
+void searchReach(vector pixel, float* shortestDistance, int* closest){
+   const int blockSize = GRID_BLOCK * gridCellSize;
+   float reach = *shortestDistance + 0.01f;
+   int blockTop = (int)((pixel.y - reach) / blockSize);
+   int blockBottom = (int)((pixel.y + reach) / blockSize);
+   int blockLeft = (int)((pixel.x - reach) / blockSize);
+   int blockRight = (int)((pixel.x + reach) / blockSize);
+   blockTop = blockTop < 0 ? 0 : blockTop;
+   blockLeft = blockLeft < 0 ? 0 : blockLeft;
+   blockBottom = blockBottom >= gridBlockRows ? gridBlockRows - 1 : blockBottom;
+   blockRight = blockRight >= gridBlockColumns ? gridBlockColumns - 1 : blockRight;
+
+   for(int blockRow = blockTop; blockRow <= blockBottom; ++blockRow){
+      for(int blockColumn = blockLeft; blockColumn <= blockRight; ++blockColumn){
+         reach = *shortestDistance + 0.01f;
+         if(gridBlockCount[blockRow * gridBlockColumns + blockColumn] == 0 ||
+            !areaInReach(pixel, blockColumn * blockSize, blockRow * blockSize, blockSize, reach)){
+            continue;
+         }
+         // Cells of the block inside the reach box
+         int rowStart = (int)((pixel.y - reach) / gridCellSize);
+         int rowEnd = (int)((pixel.y + reach) / gridCellSize) + 1;
+         int columnStart = (int)((pixel.x - reach) / gridCellSize);
+         int columnEnd = (int)((pixel.x + reach) / gridCellSize) + 1;
+         rowStart = rowStart > blockRow * GRID_BLOCK ? rowStart : blockRow * GRID_BLOCK;
+         columnStart = columnStart > blockColumn * GRID_BLOCK ? columnStart : blockColumn * GRID_BLOCK;
+         rowEnd = rowEnd < (blockRow + 1) * GRID_BLOCK ? rowEnd : (blockRow + 1) * GRID_BLOCK;
+         columnEnd = columnEnd < (blockColumn + 1) * GRID_BLOCK ? columnEnd : (blockColumn + 1) * GRID_BLOCK;
+         rowEnd = rowEnd < gridRows ? rowEnd : gridRows;
+         columnEnd = columnEnd < gridColumns ? columnEnd : gridColumns;
+         for(int row = rowStart; row < rowEnd; ++row){
+            for(int column = columnStart; column < columnEnd; ++column){
+               int cell = row * gridColumns + column;
+               if(gridCellStart[cell] == gridCellStart[cell + 1] ||
+                  !areaInReach(pixel, column * gridCellSize, row * gridCellSize, gridCellSize,
+                     *shortestDistance + 0.01f)){
+                  continue;
+               }
+               searchCell(cell, pixel, shortestDistance, closest);
+            }
+         }
+      }
+   }
+}
+
+// Searches grid cells in growing rings around the pixel. Satelites not yet
+// visited are outside the searched square of cells, so search ends when the
+// closest distance found is shorter than distance to the square edge.
+// Along a row the closest satelite of previous pixel is given as a hint,
+// then only cells within its distance need to be checked.
+color gridPixel(int x, int y, int* closest){
+   vector pixel = {.x = x, .y = y};
+   int column = x / gridCellSize;
+   int row = y / gridCellSize;
+   float shortestDistance = INFINITY;
+
+   if(*closest >= 0){
+      vector difference = {.x = pixel.x - satelites[*closest].position.x,
+                           .y = pixel.y - satelites[*closest].position.y};
+      shortestDistance = sqrtf(difference.x * difference.x +
+         difference.y * difference.y);
+      searchReach(pixel, &shortestDistance, closest);
+   }
+   else{
+      for(int ring = 0; ; ++ring){
+         searchRingSide(row - ring, column - ring, column + ring, 1, pixel, &shortestDistance, closest);
+         if(ring > 0){
+            searchRingSide(row + ring, column - ring, column + ring, 1, pixel, &shortestDistance, closest);
+            searchRingSide(column - ring, row - ring + 1, row + ring - 1, 0, pixel, &shortestDistance, closest);
+            searchRingSide(column + ring, row - ring + 1, row + ring - 1, 0, pixel, &shortestDistance, closest);
+         }
+
+         // Distance to the nearest unsearched cell, sides at grid edge have none
+         float edge = INFINITY;
+         if(column - ring > 0 && x - (column - ring) * gridCellSize < edge){
+            edge = x - (column - ring) * gridCellSize;
+         }
+         if(column + ring + 1 < gridColumns && (column + ring + 1) * gridCellSize - x < edge){
+            edge = (column + ring + 1) * gridCellSize - x;
+         }
+         if(row - ring > 0 && y - (row - ring) * gridCellSize < edge){
+            edge = y - (row - ring) * gridCellSize;
+         }
+         if(row + ring + 1 < gridRows && (row + ring + 1) * gridCellSize - y < edge){
+            edge = (row + ring + 1) * gridCellSize - y;
+         }
+         if(shortestDistance + 0.01f < edge || edge == INFINITY){
+            break;
+         }
+      }
+   }
+
+   // Display satelites themselves with white, closest one is inside radius if any is
+   color renderColor = satelites[*closest].identifier;
+   if(shortestDistance < SATELITE_RADIUS){
+      renderColor.red = 1.0f;
+      renderColor.green = 1.0f;
+      renderColor.blue = 1.0f;
+   }
+   return renderColor;
+}
+
+void gridGraphicsEngine(){
+   buildGrid();
+
+   #pragma omp parallel for schedule(static)
+   for(int y = 0; y < WINDOW_HEIGHT; ++y){
+      int closest = -1;
+      for(int x = 0; x < WINDOW_WIDTH; ++x){
+         pixels[y * WINDOW_WIDTH + x] = gridPixel(x, y, &closest);
+      }
+   }
+}
+#endif
+
+#if RENDER_ENGINE == SIMD
+// Vector engines keep the closest distance and satelite index of every lane.
+// Distances are computed with separate multiply and add and a correctly
+// rounded square root, which gives the same floats as the sequential engine.
+// Strict less than over satelites in index order keeps the first index on ties.
+// Disk test is done once per lane: some satelite is inside the radius only
+// if the closest one is.
+
+// Writes colors of count pixels from closest distances and satelite indices
+void writeSimdColors(int i, int count, const float* shortestDistance, const int* closest){
+   for(int k = 0; k < count; ++k){
+      color renderColor = satelites[closest[k]].identifier;
+      if(shortestDistance[k] < SATELITE_RADIUS){
+         renderColor.red = 1.0f;
+         renderColor.green = 1.0f;
+         renderColor.blue = 1.0f;
+      }
+      pixels[i + k] = renderColor;
+   }
+}
+
+__attribute__((target("avx512f")))
+void renderRowAvx512(int y, int x0, int count){
+   float shortestDistance[16];
+   int closest[16];
+   __m512 pixelY = _mm512_set1_ps((float)y);
+   __m512 laneOffset = _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+   int x = x0;
+   for(; x + 16 <= x0 + count; x += 16){
+      __m512 pixelX = _mm512_add_ps(_mm512_set1_ps((float)x), laneOffset);
+      __m512 best = _mm512_set1_ps(INFINITY);
+      __m512i bestIndex = _mm512_setzero_si512();
+      for(int j = 0; j < SATELITE_COUNT; ++j){
+         __m512 dx = _mm512_sub_ps(pixelX, _mm512_set1_ps(sateliteX[j]));
+         __m512 dy = _mm512_sub_ps(pixelY, _mm512_set1_ps(sateliteY[j]));
+         __m512 distance = _mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)));
+         __mmask16 closer = _mm512_cmp_ps_mask(distance, best, _CMP_LT_OQ);
+         best = _mm512_mask_mov_ps(best, closer, distance);
+         bestIndex = _mm512_mask_mov_epi32(bestIndex, closer, _mm512_set1_epi32(j));
+      }
+      _mm512_storeu_ps(shortestDistance, best);
+      _mm512_storeu_si512((void*)closest, bestIndex);
+      writeSimdColors(y * WINDOW_WIDTH + x, 16, shortestDistance, closest);
+   }
+   for(; x < x0 + count; ++x){
+      pixels[y * WINDOW_WIDTH + x] = bruteForcePixel(y * WINDOW_WIDTH + x);
+   }
+}
+
+__attribute__((target("avx2")))
+void renderRowAvx2(int y, int x0, int count){
+   float shortestDistance[8];
+   int closest[8];
+   __m256 pixelY = _mm256_set1_ps((float)y);
+   __m256 laneOffset = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+   int x = x0;
+   for(; x + 8 <= x0 + count; x += 8){
+      __m256 pixelX = _mm256_add_ps(_mm256_set1_ps((float)x), laneOffset);
+      __m256 best = _mm256_set1_ps(INFINITY);
+      __m256i bestIndex = _mm256_setzero_si256();
+      for(int j = 0; j < SATELITE_COUNT; ++j){
+         __m256 dx = _mm256_sub_ps(pixelX, _mm256_set1_ps(sateliteX[j]));
+         __m256 dy = _mm256_sub_ps(pixelY, _mm256_set1_ps(sateliteY[j]));
+         __m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+         __m256 closer = _mm256_cmp_ps(distance, best, _CMP_LT_OQ);
+         best = _mm256_blendv_ps(best, distance, closer);
+         bestIndex = _mm256_blendv_epi8(bestIndex, _mm256_set1_epi32(j), _mm256_castps_si256(closer));
+      }
+      _mm256_storeu_ps(shortestDistance, best);
+      _mm256_storeu_si256((__m256i*)closest, bestIndex);
+      writeSimdColors(y * WINDOW_WIDTH + x, 8, shortestDistance, closest);
+   }
+   for(; x < x0 + count; ++x){
+      pixels[y * WINDOW_WIDTH + x] = bruteForcePixel(y * WINDOW_WIDTH + x);
+   }
+}
+
+void renderRowSse2(int y, int x0, int count){
+   float shortestDistance[4];
+   int closest[4];
+   __m128 pixelY = _mm_set1_ps((float)y);
+   __m128 laneOffset = _mm_setr_ps(0, 1, 2, 3);
+   int x = x0;
+   for(; x + 4 <= x0 + count; x += 4){
+      __m128 pixelX = _mm_add_ps(_mm_set1_ps((float)x), laneOffset);
+      __m128 best = _mm_set1_ps(INFINITY);
+      __m128i bestIndex = _mm_setzero_si128();
+      for(int j = 0; j < SATELITE_COUNT; ++j){
+         __m128 dx = _mm_sub_ps(pixelX, _mm_set1_ps(sateliteX[j]));
+         __m128 dy = _mm_sub_ps(pixelY, _mm_set1_ps(sateliteY[j]));
+         __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+         __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+         best = _mm_min_ps(distance, best);
+         bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(j)),
+            _mm_andnot_si128(closer, bestIndex));
+      }
+      _mm_storeu_ps(shortestDistance, best);
+      _mm_storeu_si128((__m128i*)closest, bestIndex);
+      writeSimdColors(y * WINDOW_WIDTH + x, 4, shortestDistance, closest);
+   }
+   for(; x < x0 + count; ++x){
+      pixels[y * WINDOW_WIDTH + x] = bruteForcePixel(y * WINDOW_WIDTH + x);
+   }
+}
 
-// Window handling includes
-#ifndef __APPLE__
-#include <GL/gl.h>
-#include <GL/glut.h>
-#else
-#include <OpenGL/gl.h>
-#include <GLUT/glut.h>
-#endif
-// These are used to 8 the window size
-#define WINDOW_HEIGHT 1024
-#define WINDOW_WIDTH  1024
+// Picks the widest instruction set supported by the CPU
+void selectSimdRenderRow(){
+   __builtin_cpu_init();
+   if(__builtin_cpu_supports("avx512f")){
+      printf("SIMD render engine: AVX-512\n");
+      simdRenderRow = renderRowAvx512;
+   }
+   else if(__builtin_cpu_supports("avx2")){
+      printf("SIMD render engine: AVX2\n");
+      simdRenderRow = renderRowAvx2;
+   }
+   else{
+      printf("SIMD render engine: SSE2\n");
+      simdRenderRow = renderRowSse2;
+   }
+}
 
-// The number of satelites can be changed to see how it affects performance
-#define SATELITE_COUNT 35
+void simdGraphicsEngine(){
+   for(int j = 0; j < SATELITE_COUNT; ++j){
+      sateliteX[j] = satelites[j].position.x;
+      sateliteY[j] = satelites[j].position.y;
+   }
 
-// These are used to control the satelite movement
-#define SATELITE_RADIUS 3.16f
-#define MAX_VELOCITY 0.1f
-#define GRAVITY 1.0f
+   #pragma omp parallel for schedule(static)
+   for(int y = 0; y < WINDOW_HEIGHT; ++y){
+      simdRenderRow(y, 0, WINDOW_WIDTH);
+   }
+}
+#endif
 
-// Some helpers to window size variables
-#define SIZE WINDOW_HEIGHT*WINDOW_HEIGHT
-#define HORIZONTAL_CENTER (WINDOW_WIDTH / 2)
-#define VERTICAL_CENTER (WINDOW_HEIGHT / 2)
+#if RENDER_ENGINE == DELAUNAY
+static inline double vertexX(int v){
+   return vertexPositionX[v];
+}
 
-// Is used to find out frame times
-int previousFrameTimeSinceStart = 0;
-unsigned int frameNumber = 0;
-unsigned int seed = 0;
+static inline double vertexY(int v){
+   return vertexPositionY[v];
+}
 
-// Stores 2D data like the coordinates
-typedef struct{
-   float x;
-   float y;
-} vector;
+// Positive if (px, py) is left of the edge a -> b
+static inline double orientation(int a, int b, double px, double py){
+   return (vertexX(b) - vertexX(a)) * (py - vertexY(a)) -
+      (vertexY(b) - vertexY(a)) * (px - vertexX(a));
+}
 
-// Stores rendered colors. Each float may vary from 0.0f ... 1.0f
-typedef struct{
-   float red;
-   float green;
-   float blue;
-} color;
+static inline double triangleOrientation(int t){
+   const int* v = triangleVertex + 3 * t;
+   return orientation(v[0], v[1], vertexX(v[2]), vertexY(v[2]));
+}
 
-// Stores the satelite data, which fly around black hole in the space
-typedef struct{
-   color identifier;
-   vector position;
-   vector velocity;
-} satelite;
+// Positive if (px, py) is inside circumcircle of counter clockwise triangle t
+static inline double inCircumcircle(int t, double px, double py){
+   const int* v = triangleVertex + 3 * t;
+   double adx = vertexX(v[0]) - px, ady = vertexY(v[0]) - py;
+   double bdx = vertexX(v[1]) - px, bdy = vertexY(v[1]) - py;
+   double cdx = vertexX(v[2]) - px, cdy = vertexY(v[2]) - py;
+   return (adx * adx + ady * ady) * (bdx * cdy - cdx * bdy) +
+      (bdx * bdx + bdy * bdy) * (cdx * ady - adx * cdy) +
+      (cdx * cdx + cdy * cdy) * (adx * bdy - bdx * ady);
+}
 
-// Pixel buffer which is rendered to the screen
-color* pixels;
+// Index of the vertex of triangle u which is not a or b
+static inline int oppositeIndex(int u, int a, int b){
+   const int* v = triangleVertex + 3 * u;
+   for(int i = 0; i < 2; ++i){
+      if(v[i] != a && v[i] != b){
+         return i;
+      }
+   }
+   return 2;
+}
 
-// Pixel buffer which is used for error checking
-color* correctPixels;
+// Satelites ordered by stripe, then y in snake order, then x, then index so
+// that equal positions are adjacent
+int compareInsertOrder(const void* first, const void* second){
+   const satelite* a = satelites + *(const int*)first;
+   const satelite* b = satelites + *(const int*)second;
+   int stripeA = (int)((a->position.x - stripeLeft) / stripeWidth);
+   int stripeB = (int)((b->position.x - stripeLeft) / stripeWidth);
+   if(stripeA != stripeB){
+      return stripeA < stripeB ? -1 : 1;
+   }
+   if(a->position.y != b->position.y){
+      return (a->position.y < b->position.y) == (stripeA % 2 == 0) ? -1 : 1;
+   }
+   if(a->position.x != b->position.x){
+      return a->position.x < b->position.x ? -1 : 1;
+   }
+   return *(const int*)first - *(const int*)second;
+}
 
-// Buffer for all satelites in the space
-satelite* satelites;
+// Visibility walk from triangle t to the triangle containing (px, py), -1 if lost
+int locateTriangle(int t, double px, double py){
+   for(int step = 0; step <= triangleCount; ++step){
+      int i = 0;
+      const int* v = triangleVertex + 3 * t;
+      while(i < 3 && orientation(v[(i + 1) % 3], v[(i + 2) % 3], px, py) >= 0.0){
+         ++i;
+      }
+      if(i == 3){
+         return t;
+      }
+      t = triangleNeighbor[3 * t + i];
+      if(t < 0){
+         return -1;
+      }
+   }
+   return -1;
+}
 
-// ## You may add your own variables here ##
+// Bowyer-Watson insertion: triangles whose circumcircle contains the satelite
+// are removed and the hole is filled with triangles fanning from it.
+// Returns a triangle of the new fan, -1 if float rounding broke the cavity.
+int insertVertex(int p, int hint){
+   double px = vertexX(p);
+   double py = vertexY(p);
+   int t = locateTriangle(hint, px, py);
+   if(t < 0){
+      return -1;
+   }
 
+   ++markStamp;
+   int cavityCount = 0;
+   cavity[cavityCount++] = t;
+   triangleMark[t] = markStamp;
+   for(int c = 0; c < cavityCount; ++c){
+      for(int i = 0; i < 3; ++i){
+         int u = triangleNeighbor[3 * cavity[c] + i];
+         if(u >= 0 && triangleMark[u] != markStamp && inCircumcircle(u, px, py) > 0.0){
+            triangleMark[u] = markStamp;
+            cavity[cavityCount++] = u;
+         }
+      }
+   }
 
-// ## You may add your own initialization routines here ##
-void init(){
+   // Cavity boundary, a star shaped hole has two edges more than triangles
+   int boundaryCount = 0;
+   for(int c = 0; c < cavityCount; ++c){
+      const int* v = triangleVertex + 3 * cavity[c];
+      for(int i = 0; i < 3; ++i){
+         int u = triangleNeighbor[3 * cavity[c] + i];
+         if(u >= 0 && triangleMark[u] == markStamp){
+            continue;
+         }
+         if(boundaryCount == cavityCount + 2 ||
+            orientation(v[(i + 1) % 3], v[(i + 2) % 3], px, py) <= 0.0){
+            return -1;
+         }
+         boundaryA[boundaryCount] = v[(i + 1) % 3];
+         boundaryB[boundaryCount] = v[(i + 2) % 3];
+         boundaryOuter[boundaryCount] = u;
+         ++boundaryCount;
+      }
+   }
+   if(boundaryCount != cavityCount + 2 || triangleCount + 2 > TRIANGLE_CAPACITY){
+      return -1;
+   }
 
+   for(int b = 0; b < boundaryCount; ++b){
+      newTriangles[b] = b < cavityCount ? cavity[b] : triangleCount++;
+   }
+   for(int b = 0; b < boundaryCount; ++b){
+      int n = newTriangles[b];
+      int outer = boundaryOuter[b];
+      triangleVertex[3 * n] = p;
+      triangleVertex[3 * n + 1] = boundaryA[b];
+      triangleVertex[3 * n + 2] = boundaryB[b];
+      triangleNeighbor[3 * n] = outer;
+      if(outer >= 0){
+         triangleNeighbor[3 * outer + oppositeIndex(outer, boundaryA[b], boundaryB[b])] = n;
+      }
+      // Fan neighbours share edges p-a and b-p
+      for(int o = 0; o < boundaryCount; ++o){
+         if(boundaryB[o] == boundaryA[b]){
+            triangleNeighbor[3 * n + 2] = newTriangles[o];
+         }
+         if(boundaryA[o] == boundaryB[b]){
+            triangleNeighbor[3 * n + 1] = newTriangles[o];
+         }
+      }
+   }
+   return newTriangles[0];
+}
 
+// Builds the triangulation from scratch, returns 0 on failure
+int triangulate(){
+   // Enclosing triangle far enough that it is never closest to a pixel
+   double left = 0.0, right = WINDOW_WIDTH, bottom = 0.0, top = WINDOW_HEIGHT;
+   for(int j = 0; j < SATELITE_COUNT; ++j){
+      double x = satelites[j].position.x;
+      double y = satelites[j].position.y;
+      if(!(x > -1e6 && x < 1e6 && y > -1e6 && y < 1e6)){
+         return 0;
+      }
+      left = x < left ? x : left;
+      right = x > right ? x : right;
+      bottom = y < bottom ? y : bottom;
+      top = y > top ? y : top;
+   }
+   double centerX = 0.5 * (left + right);
+   double centerY = 0.5 * (bottom + top);
+   double extent = (right - left > top - bottom ? right - left : top - bottom) + 1.0;
+   for(int j = 0; j < SATELITE_COUNT; ++j){
+      vertexPositionX[j] = satelites[j].position.x;
+      vertexPositionY[j] = satelites[j].position.y;
+   }
+   vertexPositionX[SATELITE_COUNT] = centerX - 20.0 * extent;
+   vertexPositionY[SATELITE_COUNT] = centerY - 10.0 * extent;
+   vertexPositionX[SATELITE_COUNT + 1] = centerX + 20.0 * extent;
+   vertexPositionY[SATELITE_COUNT + 1] = centerY - 10.0 * extent;
+   vertexPositionX[SATELITE_COUNT + 2] = centerX;
+   vertexPositionY[SATELITE_COUNT + 2] = centerY + 20.0 * extent;
+
+   triangleCount = 1;
+   triangleVertex[0] = SATELITE_COUNT;
+   triangleVertex[1] = SATELITE_COUNT + 1;
+   triangleVertex[2] = SATELITE_COUNT + 2;
+   triangleNeighbor[0] = triangleNeighbor[1] = triangleNeighbor[2] = -1;
+
+   for(int j = 0; j < SATELITE_COUNT; ++j){
+      insertOrder[j] = j;
+   }
+   stripeLeft = left;
+   stripeWidth = extent / sqrt(SATELITE_COUNT / 4.0 + 1.0);
+   qsort(insertOrder, SATELITE_COUNT, sizeof(int), compareInsertOrder);
+
+   int hint = 0;
+   for(int q = 0; q < SATELITE_COUNT; ++q){
+      int j = insertOrder[q];
+      duplicateOf[j] = -1;
+      if(q > 0){
+         int previous = insertOrder[q - 1];
+         int kept = duplicateOf[previous] < 0 ? previous : duplicateOf[previous];
+         if(satelites[kept].position.x == satelites[j].position.x &&
+            satelites[kept].position.y == satelites[j].position.y){
+            duplicateOf[j] = kept;
+            continue;
+         }
+      }
+      hint = insertVertex(j, hint);
+      if(hint < 0){
+         return 0;
+      }
+   }
+   return 1;
 }
 
-// ## You are asked to make this code parallel ##
-// Physics engine loop. (This is called once a frame before graphics engine) 
-// Moves the satelites based on gravity
-// This is done multiple times in a frame because the Euler integration 
-// is not accurate enough to be done only once
-void parallelPhysicsEngine(int deltaTime){
-	const int physicsUpdatesInOneFrame = 10000;
-	#pragma omp parallel for
-   for(int i = 0; i < SATELITE_COUNT; ++i){
-      // Distance to the blackhole (bit ugly code because C-struct cannot have member functions)
-      vector positionToBlackHole = {.x = satelites[i].position.x -
-         HORIZONTAL_CENTER, .y = satelites[i].position.y - VERTICAL_CENTER};
-      float distToBlackHoleSquared = 
-         positionToBlackHole.x * positionToBlackHole.x +
-         positionToBlackHole.y * positionToBlackHole.y;
-      float distToBlackHole = sqrt(distToBlackHoleSquared);
+// Replaces edge opposite to vertex i of triangle t, shared with triangle u,
+// by the other diagonal of the quadrilateral
+void flipEdge(int t, int i){
+   int u = triangleNeighbor[3 * t + i];
+   int a = triangleVertex[3 * t + i];
+   int b = triangleVertex[3 * t + (i + 1) % 3];
+   int c = triangleVertex[3 * t + (i + 2) % 3];
+   int j = oppositeIndex(u, b, c);
+   int d = triangleVertex[3 * u + j];
+   int oppositeCA = triangleNeighbor[3 * t + (i + 1) % 3];
+   int oppositeAB = triangleNeighbor[3 * t + (i + 2) % 3];
+   int oppositeBD = triangleNeighbor[3 * u + (j + 1) % 3];
+   int oppositeDC = triangleNeighbor[3 * u + (j + 2) % 3];
+
+   triangleVertex[3 * t] = a;
+   triangleVertex[3 * t + 1] = b;
+   triangleVertex[3 * t + 2] = d;
+   triangleNeighbor[3 * t] = oppositeBD;
+   triangleNeighbor[3 * t + 1] = u;
+   triangleNeighbor[3 * t + 2] = oppositeAB;
+
+   triangleVertex[3 * u] = d;
+   triangleVertex[3 * u + 1] = c;
+   triangleVertex[3 * u + 2] = a;
+   triangleNeighbor[3 * u] = oppositeCA;
+   triangleNeighbor[3 * u + 1] = t;
+   triangleNeighbor[3 * u + 2] = oppositeDC;
+
+   if(oppositeBD >= 0){
+      triangleNeighbor[3 * oppositeBD + oppositeIndex(oppositeBD, b, d)] = t;
+   }
+   if(oppositeCA >= 0){
+      triangleNeighbor[3 * oppositeCA + oppositeIndex(oppositeCA, c, a)] = u;
+   }
+}
 
-      // Gravity force
-      vector normalizedDirection = { 
-         .x = positionToBlackHole.x / distToBlackHole,
-         .y = positionToBlackHole.y / distToBlackHole};
-      float accumulation = GRAVITY / distToBlackHoleSquared;
+// Flips edges until all of them are locally Delaunay (Lawson).
+// Returns 0 if float rounding made a flip invert a triangle.
+int flipToDelaunay(){
+   // cavity is used as stack of triangles to check, marked while on stack
+   ++markStamp;
+   int stackSize = 0;
+   for(int t = 0; t < triangleCount; ++t){
+      cavity[stackSize++] = t;
+      triangleMark[t] = markStamp;
+   }
+   int flipLimit = 8 * triangleCount;
+   while(stackSize > 0){
+      int t = cavity[--stackSize];
+      triangleMark[t] = 0;
+      for(int i = 0; i < 3; ++i){
+         int u = triangleNeighbor[3 * t + i];
+         if(u < 0){
+            continue;
+         }
+         int d = triangleVertex[3 * u + oppositeIndex(u, triangleVertex[3 * t + (i + 1) % 3],
+            triangleVertex[3 * t + (i + 2) % 3])];
+         if(inCircumcircle(t, vertexX(d), vertexY(d)) <= 0.0){
+            continue;
+         }
+         flipEdge(t, i);
+         if(--flipLimit < 0 || triangleOrientation(t) <= 0.0 || triangleOrientation(u) <= 0.0){
+            return 0;
+         }
+         if(triangleMark[u] != markStamp){
+            cavity[stackSize++] = u;
+            triangleMark[u] = markStamp;
+         }
+         cavity[stackSize++] = t;
+         triangleMark[t] = markStamp;
+         break;
+      }
+   }
+   return 1;
+}
 
-      // Delta time is used to make velocity same despite different FPS
-      // Update velocity based on force
-      
-      for(int physicsUpdateIndex = 0; physicsUpdateIndex < physicsUpdatesInOneFrame; ++physicsUpdateIndex){
-	      satelites[i].velocity.x -= accumulation * normalizedDirection.x * deltaTime / physicsUpdatesInOneFrame;
-	      satelites[i].velocity.y -= accumulation * normalizedDirection.y * deltaTime / physicsUpdatesInOneFrame;
+// Kinetic update: satelites are moved along straight lines from the positions
+// the triangulation is valid for to their current positions. Each step is
+// short enough that no triangle gets inverted and the edges which stopped
+// being Delaunay are flipped before the next step. Satelites move only a
+// fraction of a pixel per frame so usually one step with few flips is enough.
+// Returns 0 if the triangulation must be rebuilt.
+int restoreDelaunay(){
+   for(int j = 0; j < SATELITE_COUNT; ++j){
+      int kept = duplicateOf[j];
+      if(kept >= 0 && (satelites[kept].position.x != satelites[j].position.x ||
+         satelites[kept].position.y != satelites[j].position.y)){
+         return 0;
+      }
+      startPositionX[j] = vertexPositionX[j];
+      startPositionY[j] = vertexPositionY[j];
+   }
 
-	      // Update position based on velocity
-	      satelites[i].position.x = satelites[i].position.x + satelites[i].velocity.x * deltaTime / physicsUpdatesInOneFrame;
-	      satelites[i].position.y = satelites[i].position.y + satelites[i].velocity.y * deltaTime / physicsUpdatesInOneFrame;
+   double done = 0.0;
+   double step = 1.0;
+   for(int steps = 0; done < 1.0; ++steps){
+      if(steps == KINETIC_STEP_LIMIT){
+         // Satelites moved so much that rebuilding is cheaper
+         return 0;
+      }
+      double fraction = done + step < 1.0 ? done + step : 1.0;
+      for(int j = 0; j < SATELITE_COUNT; ++j){
+         vertexPositionX[j] = fraction == 1.0 ? satelites[j].position.x :
+            startPositionX[j] + fraction * (satelites[j].position.x - startPositionX[j]);
+         vertexPositionY[j] = fraction == 1.0 ? satelites[j].position.y :
+            startPositionY[j] + fraction * (satelites[j].position.y - startPositionY[j]);
+      }
+      int inverted = 0;
+      for(int t = 0; t < triangleCount && !inverted; ++t){
+         inverted = triangleOrientation(t) <= 0.0;
       }
+      if(inverted){
+         step *= 0.5;
+         continue;
+      }
+      if(!flipToDelaunay()){
+         return 0;
+      }
+      done = fraction;
+      step *= 2.0;
    }
+   return 1;
 }
 
-// ## You are asked to make this code parallel ##
-// Rendering loop (This is called once a frame after physics engine) 
-// Decides the color for each pixel.
-void parallelGraphicsEngine(){
-	#pragma omp parallel for
-   for(int i=0; i < SIZE; ++i) {
+// Directed edges between satelites, every edge is in one triangle per direction
+void buildNeighborLists(){
+   for(int j = 0; j <= SATELITE_COUNT; ++j){
+      neighborStart[j] = 0;
+   }
+   for(int t = 0; t < triangleCount; ++t){
+      const int* v = triangleVertex + 3 * t;
+      for(int i = 0; i < 3; ++i){
+         if(v[i] < SATELITE_COUNT && v[(i + 1) % 3] < SATELITE_COUNT){
+            neighborStart[v[i] + 1]++;
+         }
+      }
+   }
+   for(int j = 0; j < SATELITE_COUNT; ++j){
+      neighborStart[j + 1] += neighborStart[j];
+   }
+   for(int t = 0; t < triangleCount; ++t){
+      const int* v = triangleVertex + 3 * t;
+      for(int i = 0; i < 3; ++i){
+         if(v[i] < SATELITE_COUNT && v[(i + 1) % 3] < SATELITE_COUNT){
+            neighborList[neighborStart[v[i]]++] = v[(i + 1) % 3];
+         }
+      }
+   }
+   for(int j = SATELITE_COUNT; j > 0; --j){
+      neighborStart[j] = neighborStart[j - 1];
+   }
+   neighborStart[0] = 0;
+}
 
-      // Row wise ordering
-      vector pixel = {.x = i % WINDOW_WIDTH, .y = i / WINDOW_WIDTH};
+static inline float pixelDistance(vector pixel, int j){
+   vector difference = {.x = pixel.x - satelites[j].position.x,
+                        .y = pixel.y - satelites[j].position.y};
+   return sqrt(difference.x * difference.x + difference.y * difference.y);
+}
 
-      // This color is used for coloring the pixel
-      color renderColor = {.red = 0.f, .green = 0.f, .blue = 0.f};
+// Satelites exactly as far as the end of a walk lie on one empty circle and are
+// connected by its Delaunay edges, so following equally far neighbours finds all
+// of them and the first index among them. Returns a closer satelite instead if
+// rounding made one, then shortestDistance is lowered and the walk goes on.
+static int delaunayTies(vector pixel, int closest, float* shortestDistance){
+   int tied[DELAUNAY_TIES];
+   int count = 1;
+   int first = closest;
+   tied[0] = closest;
+   for(int t = 0; t < count; ++t){
+      for(int k = neighborStart[tied[t]]; k < neighborStart[tied[t] + 1]; ++k){
+         int j = neighborList[k];
+         float distance = pixelDistance(pixel, j);
+         if(distance < *shortestDistance){
+            *shortestDistance = distance;
+            return j;
+         }
+         if(distance > *shortestDistance){
+            continue;
+         }
+         int seen = 0;
+         for(int m = 0; m < count && !seen; ++m){
+            seen = tied[m] == j;
+         }
+         if(seen){
+            continue;
+         }
+         if(count == DELAUNAY_TIES){
+            // Too many to follow, same search as in sequential engine
+            *shortestDistance = INFINITY;
+            for(int i = 0; i < SATELITE_COUNT; ++i){
+               float distance = pixelDistance(pixel, i);
+               if(distance < *shortestDistance){
+                  *shortestDistance = distance;
+                  first = i;
+               }
+            }
+            return first;
+         }
+         tied[count++] = j;
+         first = j < first ? j : first;
+      }
+   }
+   return first;
+}
 
-      // Find closest satelite
-      float shortestDistance = INFINITY;
-      
-      for(int j = 0; j < SATELITE_COUNT; ++j){
-         vector difference = {.x = pixel.x - satelites[j].position.x,
-                              .y = pixel.y - satelites[j].position.y};
-         float distance = sqrt(difference.x * difference.x + 
-           difference.y * difference.y);
-         if(distance < shortestDistance){
-            shortestDistance = distance;
-            renderColor = satelites[j].identifier;
+// Greedy walk over Delaunay neighbours from the closest satelite of previous
+// pixel. Delaunay graph has no local minima, so the walk ends at the closest
+// satelite. Distances are compared like in sequential engine and if equally
+// far neighbours remain at the end, first index of all tied satelites wins.
+static inline int delaunayWalk(vector pixel, int closest, float* shortestDistance){
+   *shortestDistance = pixelDistance(pixel, closest);
+   for(;;){
+      int next = closest;
+      int tie = 0;
+      for(int k = neighborStart[closest]; k < neighborStart[closest + 1]; ++k){
+         int j = neighborList[k];
+         float distance = pixelDistance(pixel, j);
+         if(distance < *shortestDistance){
+            *shortestDistance = distance;
+            next = j;
+            tie = 0;
          }
-         // Display satelites themselves with white
-         if(distance < SATELITE_RADIUS){
-            renderColor.red = 1.0f;
-            renderColor.green = 1.0f;
-            renderColor.blue = 1.0f;
+         else if(distance == *shortestDistance){
+            tie = 1;
+            next = j < next ? j : next;
+         }
+      }
+      if(next != closest){
+         closest = next;
+         continue;
+      }
+      if(!tie){
+         return closest;
+      }
+      float tiedDistance = *shortestDistance;
+      next = delaunayTies(pixel, closest, shortestDistance);
+      if(*shortestDistance == tiedDistance){
+         return next;
+      }
+      closest = next;
+   }
+}
+
+void delaunayGraphicsEngine(){
+   if(!triangulationValid || !restoreDelaunay()){
+      triangulationValid = triangulate();
+   }
+   if(!triangulationValid){
+      // Degenerate input, render this frame without the triangulation
+      #pragma omp parallel for
+      for(int i = 0; i < SIZE; ++i){
+         pixels[i] = bruteForcePixel(i);
+      }
+      return;
+   }
+   buildNeighborLists();
+
+   #pragma omp parallel
+   {
+      // Rows of a thread are consecutive, start of the row continues from previous row
+      int rowStart = insertOrder[0];
+      #pragma omp for schedule(static)
+      for(int y = 0; y < WINDOW_HEIGHT; ++y){
+         int closest = rowStart;
+         for(int x = 0; x < WINDOW_WIDTH; ++x){
+            vector pixel = {.x = x, .y = y};
+            float shortestDistance;
+            closest = delaunayWalk(pixel, closest, &shortestDistance);
+            if(x == 0){
+               rowStart = closest;
+            }
+
+            // Display satelites themselves with white, closest one is inside radius if any is
+            color renderColor = satelites[closest].identifier;
+            if(shortestDistance < SATELITE_RADIUS){
+               renderColor.red = 1.0f;
+               renderColor.green = 1.0f;
+               renderColor.blue = 1.0f;
+            }
+            pixels[y * WINDOW_WIDTH + x] = renderColor;
          }
       }
+   }
+}
+#endif
 
-      pixels[i] = renderColor;
+// ## You are asked to make this code parallel ##
+// Rendering loop (This is called once a frame after physics engine) 
+// Decides the color for each pixel.
+void parallelGraphicsEngine(){
+#if RENDER_ENGINE == DISTANCE_TRANSFORM
+   distanceTransformGraphicsEngine();
+#elif RENDER_ENGINE == BLOCK_FILL
+   blockFillGraphicsEngine();
+#elif RENDER_ENGINE == UNIFORM_GRID
+   gridGraphicsEngine();
+#elif RENDER_ENGINE == SIMD
+   simdGraphicsEngine();
+#elif RENDER_ENGINE == SCANLINE_SPANS
+   scanlineGraphicsEngine();
+#elif RENDER_ENGINE == DELAUNAY
+   delaunayGraphicsEngine();
+#else
+   // Owner pass over whole window, then the disks on top
+	#pragma omp parallel
+   {
+      float shortestDistance[WINDOW_WIDTH];
+      int closest[WINDOW_WIDTH];
+      #pragma omp for
+      for(int y = 0; y < WINDOW_HEIGHT; ++y){
+         closestSatelitesOfRow(y, shortestDistance, closest);
+         for(int x = 0; x < WINDOW_WIDTH; ++x){
+            pixels[y * WINDOW_WIDTH + x] = satelites[closest[x]].identifier;
+         }
+      }
    }
+   stampSateliteDisks();
+#endif
 }
 
 // ## You may add your own destrcution routines here ##
 void destroy(){
+#if RENDER_ENGINE == DISTANCE_TRANSFORM || RENDER_ENGINE == SCANLINE_SPANS
+   free(sortedSatelites);
+   free(sortedPosition);
+   free(columnStart);
+   free(envelopeOwner);
+   free(envelopeVertex);
+   free(envelopeHeight);
+   free(envelopeBoundary);
+#endif
+#if RENDER_ENGINE == UNIFORM_GRID
+   free(gridCellStart);
+   free(gridSatelites);
+   free(gridBlockCount);
+#endif
+#if RENDER_ENGINE == SIMD
+   _mm_free(sateliteX);
+   _mm_free(sateliteY);
+#endif
+#if RENDER_ENGINE == DELAUNAY
+   free(triangleVertex);
+   free(triangleNeighbor);
+   free(duplicateOf);
+   free(vertexPositionX);
+   free(vertexPositionY);
+   free(startPositionX);
+   free(startPositionY);
+   free(neighborStart);
+   free(neighborList);
+   free(insertOrder);
+   free(triangleMark);
+   free(cavity);
+   free(boundaryA);
+   free(boundaryB);
+   free(boundaryOuter);
+   free(newTriangles);
+#endif
+#if INTEGRATOR == ADAPTIVE_RK
+   free(integratorStep);
+#endif
+#if SIMD_PHYSICS
+   _mm_free(physicsPositionX);
+   _mm_free(physicsPositionY);
+   _mm_free(physicsVelocityX);
+   _mm_free(physicsVelocityY);
+#endif
+#if PARAREAL_PHYSICS
+   free(pararealBoundary);
+   free(pararealFine);
+   free(pararealCoarse);
+   free(pararealKick);
+   free(pararealStale);
+#endif
+#if GRAVITY_FIELD
+   free(attractors);
+   free(fieldX);
+   free(fieldY);
+#endif
+#if GRAVITY_MODEL != BLACK_HOLE
+   free(accelerationX);
+   free(accelerationY);
+#endif
+#if GRAVITY_MODEL == BARNES_HUT
+   free(mortonCode);
+   free(mortonOrder);
+   free(mortonScratch);
+   free(mortonOrderScratch);
+   free(radixCount);
+   free(treeNodeFirst);
+   free(treeNodeCount);
+   free(treeNodeLevel);
+   free(treeNodeChild);
+   free(treeNodeX);
+   free(treeNodeY);
+#endif
+
+}
+
+// Reads options given after the seed: --dt <ms>, --grid <pixels> and frame count of headless mode
+void parseOptions(int argc, char** argv, int* frames){
+   for(int i = 2; i < argc; ++i){
+      if(strcmp(argv[i], "--dt") == 0 && i + 1 < argc){
+         fixedDeltaTime = atoi(argv[++i]);
+         printf("Using fixed time step: %ims\n", fixedDeltaTime);
+      }
+      else if(strcmp(argv[i], "--grid") == 0 && i + 1 < argc){
+         tieGrid = atoi(argv[++i]);
+         printf("Snapping satelites to grid of %i pixels\n", tieGrid);
+      }
+      else{
+         *frames = atoi(argv[i]);
+      }
+   }
+}
 
+#if HEADLESS
+void sequentialGraphicsEngine();
+void errorCheck();
 
+// Milliseconds from monotonic clock, replaces glutGet(GLUT_ELAPSED_TIME)
+double monotonicTime(){
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
 }
 
+// FNV-1a hash of the pixel buffer, equal for equal frames of any engine
+unsigned long long pixelHash(){
+   const unsigned char* bytes = (const unsigned char*)pixels;
+   unsigned long long hash = 14695981039346656037ULL;
+   for(size_t i = 0; i < sizeof(pixels[0]) * SIZE; ++i){
+      hash = (hash ^ bytes[i]) * 1099511628211ULL;
+   }
+   return hash;
+}
 
+// Same frame loop as compute, but without window
+void runHeadless(int frames){
+   double physicsTotal = 0.0;
+   double graphicsTotal = 0.0;
+   double previousFrameTime = monotonicTime();
+   double runStart = previousFrameTime;
+   for(int frame = 0; frame < frames; ++frame){
+      double frameStart = monotonicTime();
+      int deltaTime = (int)(frameStart - previousFrameTime);
+      previousFrameTime = frameStart;
+
+      parallelPhysicsEngine(deltaTime);
+      double physicsEnd = monotonicTime();
+
+      parallelGraphicsEngine();
+      double graphicsEnd = monotonicTime();
+
+      if(frameNumber < 2){
+         sequentialGraphicsEngine();
+         errorCheck();
+      }
+      physicsTotal += physicsEnd - frameStart;
+      graphicsTotal += graphicsEnd - physicsEnd;
+      printf("Total frametime: %ims, satelite moving: %.2fms, space coloring: %.2fms.\n",
+         deltaTime, physicsEnd - frameStart, graphicsEnd - physicsEnd);
+      frameNumber++;
+   }
+   double runTime = monotonicTime() - runStart;
+   printf("Headless run of %i frames: %.2fms, average satelite moving: %.2fms, space coloring: %.2fms.\n",
+      frames, runTime, physicsTotal / frames, graphicsTotal / frames);
+   if(fixedDeltaTime > 0){
+      printf("Last frame hash: %016llx\n", pixelHash());
+   }
+}
+#endif
 
 
 
@@ -227,6 +2960,7 @@ void errorCheck(){
    printf("Error check passed!\n");
 }
 
+#if !HEADLESS
 // ¤¤ DO NOT EDIT THIS FUNCTION ¤¤
 void compute(void){
    int timeSinceStart = glutGet(GLUT_ELAPSED_TIME);
@@ -255,6 +2989,7 @@ void compute(void){
    // Render the frame
    glutPostRedisplay();
 }
+#endif
 
 // ¤¤ DO NOT EDIT THIS FUNCTION ¤¤
 // Probably not the best random number generator
@@ -328,6 +3063,7 @@ void fixedDestroy(void){
    }
 }
 
+#if !HEADLESS
 // ¤¤ DO NOT EDIT THIS FUNCTION ¤¤
 // Renders pixels-buffer to the window 
 void render(void){
@@ -336,6 +3072,7 @@ void render(void){
    glutSwapBuffers();
    frameNumber++;
 }
+#endif
 
 // DO NOT EDIT THIS FUNCTION
 // Inits glut and start mainloop
@@ -345,7 +3082,16 @@ int main(int argc, char** argv){
      seed = atoi(argv[1]);
      printf("Using seed: %i\n", seed);
    }
+   int frames = HEADLESS_FRAMES;
+   parseOptions(argc, argv, &frames);
 
+#if HEADLESS
+   atexit(fixedDestroy);
+   fixedInit(seed);
+   init();
+   runHeadless(frames);
+   return 0;
+#else
    // Init glut window
    glutInit(&argc, argv);
    glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH);
@@ -364,4 +3110,5 @@ int main(int argc, char** argv){
 
    // Start main loop
    glutMainLoop();
+#endif
 }